@@ -0,0 +1,78 @@
+/**
+ * Holds the game loop to zero heap allocations: replays every recorded
+ * session given to it through a build of the game with allocation tracking
+ * and fails if any frame after the warm-up allocated.
+ *
+ * Each run is a separate `pong --software --replay FILE
+ * --require-no-allocations`, so it covers process_input(), update() and the
+ * software renderer. A build without PONG_TRACK_ALLOCATIONS refuses
+ * --require-no-allocations, so it fails here too rather than passing with
+ * nothing counted. From the repository root:
+ *
+ *     c++ -std=c++17 -O2 -DPONG_TRACK_ALLOCATIONS $(sdl2-config --cflags) pong/main.cpp pong/ShaderProgram.cpp \
+ *         pong/helper.cpp -o pong/pong_allocations $(sdl2-config --libs) -lGL -ldl -lpthread
+ *     c++ -std=c++17 -O2 bench/allocation_test.cpp -o allocation_test
+ *     cd pong && ../allocation_test ./pong_allocations $(find ../bench/replays -name '*.replay')
+ *
+ * Prints one "scenario,status" line per replay and exits with status 1 if
+ * any of them allocated, keeping the first such run's allocation report,
+ * with the call stacks responsible, in REPORT_FILEPATH.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifdef _WINDOWS
+constexpr char NULL_DEVICE[] = "NUL";
+#else
+constexpr char NULL_DEVICE[] = "/dev/null";
+#endif
+
+constexpr char REPORT_FILEPATH[] = "allocation_test_report.txt";
+
+// The scenario a replay file stands for: its name without directories or extension
+std::string get_scenario_name(const char *filepath)
+{
+    std::string name = filepath;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) name = name.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos) name = name.substr(0, dot);
+    return name;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s PONG REPLAY...\n", argv[0]);
+        return 2;
+    }
+
+    const char *pong = argv[1];
+    int failures = 0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        // Once a run has failed, its report is the one kept
+        std::string command = std::string("\"") + pong + "\" --software --replay \"" + argv[i] +
+                              "\" --require-no-allocations --allocations " +
+                              (failures == 0 ? REPORT_FILEPATH : NULL_DEVICE) + " > " + NULL_DEVICE;
+
+        bool allocated = std::system(command.c_str()) != 0;
+        std::printf("%s,%s\n", get_scenario_name(argv[i]).c_str(), allocated ? "allocated" : "ok");
+
+        if (allocated && failures++ == 0)
+        {
+            std::fprintf(stderr, "Error: %s allocated once warmed up, or %s was built without PONG_TRACK_ALLOCATIONS; "
+                                 "see %s\n", argv[i], pong, REPORT_FILEPATH);
+        }
+        else if (failures == 0)
+        {
+            std::remove(REPORT_FILEPATH);
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
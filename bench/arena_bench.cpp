@@ -0,0 +1,112 @@
+/**
+ * Holds the spectator grid to its budget: a frame of ARENAS arenas, each
+ * playing three balls, has to be stepped, laid out into its instance
+ * batches and drawn on the CPU, the slowest backend, in under BUDGET_MS.
+ *
+ * Build and run from the repository root:
+ *
+ *     c++ -std=c++17 -O2 -I pong bench/arena_bench.cpp -o arena_bench
+ *     ./arena_bench
+ *
+ * Prints one "name,value" line per result, times as medians, and exits
+ * with status 1 when the frame at ARENAS is over budget.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "MathConfig.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+using GLuint = unsigned int;
+
+#include "Arena.h"
+#include "SoftwareRenderer.h"
+
+constexpr int    RANDOM_SEED     = 3113,
+                 ARENAS          = 64,
+                 WARMUP_FRAMES   = 60,
+                 MEASURED_FRAMES = 300,
+                 WIDTH           = 960,
+                 HEIGHT          = 720;
+constexpr float  DELTA_TIME      = 1.0f / 60.0f;
+constexpr double BUDGET_MS       = 16.0;
+
+constexpr int ARENA_COUNTS[] = { 16, ARENAS, 256 };
+
+MATH_CONSTANT glm::vec4 PLAYER_ONE_COLOUR = glm::vec4(1.0f, 0.55f, 0.2f, 1.0f),
+                        PLAYER_TWO_COLOUR = glm::vec4(0.3f, 0.7f, 1.0f, 1.0f);
+
+double median(std::vector<double> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Median milliseconds per frame of each phase, printed; returns the whole frame's
+double measure(int arena_count)
+{
+    srand(RANDOM_SEED);
+
+    ArenaGrid arenas(arena_count);
+    arenas.set_ball_count(Ball::MAX_AMOUNT);
+
+    RenderList list;
+    list.reserve_instances(arenas.get_max_batch_instances());
+
+    SoftwareRenderer renderer(WIDTH, HEIGHT);
+    renderer.set_view_projection_matrix(glm::ortho(-4.0f, 4.0f, -3.0f, 3.0f, -1.0f, 1.0f));
+
+    std::vector<double> update_ms, build_ms, render_ms, frame_ms;
+    for (int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        arenas.update(DELTA_TIME);
+        auto updated = std::chrono::steady_clock::now();
+
+        list.clear();
+        arenas.push_instances(list, PLAYER_ONE_COLOUR, PLAYER_TWO_COLOUR);
+        auto built = std::chrono::steady_clock::now();
+
+        renderer.render(list, 0.0f, 0.0f, 0.0f, 1.0f);
+        auto rendered = std::chrono::steady_clock::now();
+
+        if (frame < WARMUP_FRAMES) continue;
+        update_ms.push_back(std::chrono::duration<double, std::milli>(updated - start).count());
+        build_ms.push_back(std::chrono::duration<double, std::milli>(built - updated).count());
+        render_ms.push_back(std::chrono::duration<double, std::milli>(rendered - built).count());
+        frame_ms.push_back(std::chrono::duration<double, std::milli>(rendered - start).count());
+    }
+
+    double update = median(update_ms),
+           build  = median(build_ms);
+    std::printf("arenas_%d_update_ms,%.4f\n", arena_count, update);
+    std::printf("arenas_%d_build_ms,%.4f\n", arena_count, build);
+    std::printf("arenas_%d_software_render_ms,%.4f\n", arena_count, median(render_ms));
+    std::printf("arenas_%d_update_and_build_us_per_arena,%.3f\n", arena_count, (update + build) * 1e3 / arena_count);
+
+    double frame = median(frame_ms);
+    std::printf("arenas_%d_frame_ms,%.4f\n", arena_count, frame);
+    return frame;
+}
+
+int main()
+{
+    double budgeted_ms = 0.0;
+    for (int arena_count : ARENA_COUNTS)
+    {
+        double frame_ms = measure(arena_count);
+        if (arena_count == ARENAS) budgeted_ms = frame_ms;
+    }
+
+    std::printf("budget_ms,%.3f\n", BUDGET_MS);
+    return budgeted_ms <= BUDGET_MS ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+/**
+ * Holds chaos mode to its budget: update_chaos has to step CHAOS_BALLS
+ * live balls, with their splits, scores and particles, in under BUDGET_MS
+ * of CPU per tick, so a 60 Hz frame keeps most of its time for drawing.
+ *
+ * Build and run from the repository root:
+ *
+ *     c++ -std=c++17 -O2 -I pong bench/chaos_bench.cpp -o chaos_bench
+ *     ./chaos_bench
+ *
+ * Prints one "name,value" line per result and exits with status 1 when the
+ * median tick at CHAOS_BALLS is over budget. The pool is topped back up
+ * before every tick, so each one steps the full count.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "MathConfig.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+using GLuint = unsigned int;
+
+#include "Simulation.h"
+
+constexpr int    RANDOM_SEED    = 3113,
+                 CHAOS_BALLS    = 50000,
+                 WARMUP_TICKS   = 60,
+                 MEASURED_TICKS = 300;
+constexpr float  DELTA_TIME     = 1.0f / 60.0f;
+constexpr double BUDGET_MS      = 4.0;
+
+constexpr int BALL_COUNTS[] = { 1000, 10000, CHAOS_BALLS };
+
+// Median milliseconds per tick of a pool kept at ball_count live balls
+double measure(int ball_count, bool with_particles)
+{
+    srand(RANDOM_SEED);
+
+    Paddle player_one(-Paddle::INIT_POS, 0),
+           player_two(Paddle::INIT_POS, 0);
+    player_one.toggle_playability();
+    player_two.toggle_playability();
+
+    // Twice the count, so splits always have room
+    BallPool pool(2 * ball_count);
+    ParticleSystem particles;
+    ChaosRules rules;
+
+    std::vector<double> tick_ms;
+    for (int tick = 0; tick < WARMUP_TICKS + MEASURED_TICKS; tick++)
+    {
+        while (pool.get_live_count() < ball_count) pool.spawn(Ball());
+        while (pool.get_live_count() > ball_count) pool.despawn_at(pool.get_live_count() - 1);
+
+        auto start = std::chrono::steady_clock::now();
+        update_chaos(DELTA_TIME, &player_one, &player_two, pool, with_particles ? &particles : nullptr, rules);
+        auto end = std::chrono::steady_clock::now();
+
+        if (tick >= WARMUP_TICKS) tick_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::sort(tick_ms.begin(), tick_ms.end());
+    return tick_ms[tick_ms.size() / 2];
+}
+
+int main()
+{
+    double budgeted_ms = 0.0;
+    for (int ball_count : BALL_COUNTS)
+    {
+        double tick_ms = measure(ball_count, true);
+        std::printf("update_chaos_%d_balls_ms_per_tick,%.3f\n", ball_count, tick_ms);
+        std::printf("update_chaos_%d_balls_ns_per_ball,%.3f\n", ball_count, tick_ms * 1e6 / ball_count);
+        std::printf("update_chaos_%d_balls_no_particles_ms_per_tick,%.3f\n", ball_count, measure(ball_count, false));
+
+        if (ball_count == CHAOS_BALLS) budgeted_ms = tick_ms;
+    }
+
+    std::printf("budget_ms,%.3f\n", BUDGET_MS);
+    return budgeted_ms <= BUDGET_MS ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/**
+ * The glm maths the game leans on, to compare a scalar build against one
+ * with glm's SIMD paths (PONG_GLM_SIMD, see pong/MathConfig.h): building
+ * sprite transforms, the view-projection product, projecting sprite corners
+ * as the software renderer does, and stepping balls.
+ *
+ * Build both ways and run from the repository root:
+ *
+ *     c++ -std=c++17 -O2 -I pong bench/math_bench.cpp -o math_bench_scalar
+ *     c++ -std=c++17 -O2 -DPONG_GLM_SIMD -I pong bench/math_bench.cpp -o math_bench_simd
+ *     ./math_bench_scalar > scalar.csv && ./math_bench_simd > simd.csv
+ *     paste -d, scalar.csv simd.csv
+ *
+ * Prints one "name,value" line per result, times in nanoseconds as the
+ * median of SAMPLES batches. The last line is a digest of MATCH_TICKS ticks
+ * of a seeded CPU-against-CPU match, which has to come out the same from
+ * both builds: the vector paths may only make the game faster, never play
+ * differently.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "MathConfig.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+using GLuint = unsigned int;
+
+#include "Simulation.h"
+
+constexpr int    SAMPLES      = 31,
+                 RANDOM_SEED  = 3113,
+                 MANY_BALLS   = 16384,
+                 MATCH_TICKS  = 100000;
+constexpr double MIN_SAMPLE_MS = 2.0;
+constexpr float  DELTA_TIME    = 1.0f / 60.0f;
+
+// Keeps the compiler from optimising away a result nobody reads
+template<typename T>
+inline void do_not_optimise(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Times batches of operations and prints the median time per operation in
+ * nanoseconds, divided by per_operation for costs given per item. The batch
+ * size doubles until one batch takes MIN_SAMPLE_MS.
+ */
+template<typename Operation>
+double measure(const char *name, Operation operation, int per_operation = 1)
+{
+    using clock = std::chrono::steady_clock;
+
+    long long batch = 1;
+    while (true)
+    {
+        auto start = clock::now();
+        for (long long i = 0; i < batch; i++) operation();
+        if (std::chrono::duration<double, std::milli>(clock::now() - start).count() >= MIN_SAMPLE_MS) break;
+        batch *= 2;
+    }
+
+    std::vector<double> nanoseconds_per_operation;
+    for (int sample = 0; sample < SAMPLES; sample++)
+    {
+        auto start = clock::now();
+        for (long long i = 0; i < batch; i++) operation();
+        auto end = clock::now();
+
+        nanoseconds_per_operation.push_back(std::chrono::duration<double, std::nano>(end - start).count() / batch / per_operation);
+    }
+
+    std::sort(nanoseconds_per_operation.begin(), nanoseconds_per_operation.end());
+    double median = nanoseconds_per_operation[SAMPLES / 2];
+
+    std::printf("%s,%.3f\n", name, median);
+    return median;
+}
+
+int main()
+{
+    srand(RANDOM_SEED);
+    std::printf("glm_simd,%d\n", GLM_CONFIG_SIMD == GLM_ENABLE ? 1 : 0);
+
+    /* Sprite transforms */
+    {
+        Paddle paddle(Paddle::INIT_POS, 0),
+               other(-Paddle::INIT_POS, 0);
+        std::vector<Ball> balls(MANY_BALLS);
+
+        measure("paddle_update_transform_ns", [&] { paddle.update_transform(); do_not_optimise(paddle.get_transform()); });
+        measure("ball_update_transform_ns", [&] { balls[0].update_transform(); do_not_optimise(balls[0].get_transform()); });
+        measure("update_transforms_many_balls_ns_per_ball", [&] {
+            update_transforms(&paddle, &other, balls.data(), MANY_BALLS);
+            do_not_optimise(balls[MANY_BALLS - 1].get_transform());
+        }, MANY_BALLS);
+    }
+
+    /* Matrix products, as ShaderProgram and SoftwareRenderer make them */
+    {
+        glm::mat4 projection = glm::ortho(-4.0f, 4.0f, -3.0f, 3.0f, -1.0f, 1.0f),
+                  view = glm::translate(IDENTITY_MATRIX, glm::vec3(0.25f, -0.5f, 0.0f));
+        measure("view_projection_product_ns", [&] {
+            do_not_optimise(projection);
+            glm::mat4 view_projection = projection * view;
+            do_not_optimise(view_projection);
+        });
+
+        glm::mat4 view_projection = projection * view;
+        glm::vec4 transform = glm::vec4(Paddle::INIT_POS.x, 0.0f, Paddle::INIT_SCALE.x, Paddle::INIT_SCALE.y);
+        measure("sprite_corners_ns", [&] {
+            do_not_optimise(transform);
+            glm::vec4 low  = view_projection * glm::vec4(transform.x - 0.5f * transform.z, transform.y - 0.5f * transform.w, 0.0f, 1.0f),
+                      high = view_projection * glm::vec4(transform.x + 0.5f * transform.z, transform.y + 0.5f * transform.w, 0.0f, 1.0f);
+            do_not_optimise(low);
+            do_not_optimise(high);
+        });
+    }
+
+    /* Ball steps; they leave the court, but a step costs the same anywhere */
+    {
+        Paddle paddle(Paddle::INIT_POS, 0);
+        Ball ball;
+
+        measure("ball_update_ns", [&] {
+            ball.set_position(glm::vec3(0.0f, 0.0f, 0.0f));
+            ball.set_direction(glm::vec3(0.6f, 0.8f, 0.0f));
+            do_not_optimise(ball.update(DELTA_TIME, &paddle));
+        });
+
+        std::vector<Ball> balls(MANY_BALLS);
+        measure("ball_update_many_balls_ns_per_ball", [&] {
+            for (Ball &each : balls) do_not_optimise(each.update(DELTA_TIME, &paddle));
+        }, MANY_BALLS);
+    }
+
+    /* The same match must play out the same from every build */
+    {
+        srand(RANDOM_SEED);
+
+        Paddle player_one(-Paddle::INIT_POS, 0),
+               player_two(Paddle::INIT_POS, 0);
+        player_one.toggle_playability();
+        player_two.toggle_playability();
+
+        std::vector<Ball> balls(Ball::MAX_AMOUNT);
+        for (Ball &ball : balls) ball.enable();
+
+        uint64_t hash = MATCH_HASH_SEED;
+        for (int tick = 0; tick < MATCH_TICKS; tick++)
+        {
+            update_match(DELTA_TIME, &player_one, &player_two, balls.data(), Ball::MAX_AMOUNT, nullptr);
+            hash = hash_match(hash, &player_one, &player_two, balls.data(), Ball::MAX_AMOUNT);
+        }
+        std::printf("match_digest,%016llx\n", (unsigned long long) hash);
+    }
+
+    return 0;
+}
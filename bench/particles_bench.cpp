@@ -0,0 +1,63 @@
+/**
+ * Holds ParticleSystem::update to its budget: 100k live particles must be
+ * integrated, aged and recycled in under 1 ms of CPU per tick.
+ *
+ * Build and run from the repository root:
+ *
+ *     c++ -std=c++17 -O2 -I pong bench/particles_bench.cpp -o particles_bench
+ *     ./particles_bench
+ *
+ * Prints one "name,value" line per result and exits with status 1 when the
+ * median tick is over budget.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "ParticleSystem.h"
+
+constexpr int    LIVE_PARTICLES = 100000,
+                 WARMUP_TICKS   = 120,
+                 MEASURED_TICKS = 1000;
+constexpr float  DELTA_TIME     = 1.0f / 60.0f;
+constexpr double BUDGET_MS      = 1.0;
+
+int main()
+{
+    ParticleSystem particles;
+    std::vector<double> tick_ms;
+    tick_ms.reserve(MEASURED_TICKS);
+
+    for (int tick = 0; tick < WARMUP_TICKS + MEASURED_TICKS; tick++)
+    {
+        // Keep the pool topped up so dead slots are constantly recycled
+        int missing = LIVE_PARTICLES - particles.get_live_count();
+        if (missing > 0) particles.burst(0.0f, 0.0f, missing, 2.5f, 1.0f, 0.05f);
+
+        auto start = std::chrono::steady_clock::now();
+        particles.update(DELTA_TIME);
+        auto end = std::chrono::steady_clock::now();
+
+        if (tick >= WARMUP_TICKS) tick_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::sort(tick_ms.begin(), tick_ms.end());
+    double median = tick_ms[tick_ms.size() / 2],
+           p99    = tick_ms[tick_ms.size() * 99 / 100];
+
+    std::printf("particles_live,%d\n", particles.get_live_count());
+    std::printf("particles_update_median_ms,%.4f\n", median);
+    std::printf("particles_update_p99_ms,%.4f\n", p99);
+    std::printf("particles_update_ns_per_particle,%.3f\n", median * 1e6 / LIVE_PARTICLES);
+    std::printf("particles_budget_ms,%.4f\n", BUDGET_MS);
+
+    if (median > BUDGET_MS)
+    {
+        std::fprintf(stderr, "ParticleSystem::update is over budget: %.4f ms > %.4f ms\n", median, BUDGET_MS);
+        return 1;
+    }
+    return 0;
+}
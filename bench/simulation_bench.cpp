@@ -0,0 +1,178 @@
+/**
+ * Per-call and per-tick costs of the simulation in pong_lib.h and
+ * Simulation.h: paddle and ball updates, bounds checks, transforms and the
+ * full update_match tick at the game's 1 to 3 balls and at scaled counts.
+ *
+ * Build and run from the repository root:
+ *
+ *     c++ -std=c++17 -O2 -I pong bench/simulation_bench.cpp -o simulation_bench
+ *     ./simulation_bench > results.csv
+ *
+ * Prints one "name,value" line per result, in a fixed order, so two runs can
+ * be diffed directly. Each value is the median of SAMPLES timed batches,
+ * with batches sized to run for at least MIN_SAMPLE_MS, and rand() is
+ * seeded with a constant so every run simulates the same matches.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "MathConfig.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+using GLuint = unsigned int;
+
+#include "Simulation.h"
+
+constexpr int    SAMPLES        = 31,
+                 RANDOM_SEED    = 3113;
+constexpr double MIN_SAMPLE_MS  = 2.0;
+constexpr float  DELTA_TIME     = 1.0f / 60.0f;
+
+constexpr int TICK_BALL_COUNTS[] = { 1, 2, 3, 64, 1024, 16384 };
+
+// Keeps the compiler from optimising away a result nobody reads
+template<typename T>
+inline void do_not_optimise(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Times batches of operations and prints the median time per operation in
+ * nanoseconds. The batch size doubles until one batch takes MIN_SAMPLE_MS,
+ * so cheap calls are not swamped by the clock's own overhead.
+ */
+template<typename Operation>
+double measure(const char *name, Operation operation)
+{
+    using clock = std::chrono::steady_clock;
+
+    long long batch = 1;
+    while (true)
+    {
+        auto start = clock::now();
+        for (long long i = 0; i < batch; i++) operation();
+        if (std::chrono::duration<double, std::milli>(clock::now() - start).count() >= MIN_SAMPLE_MS) break;
+        batch *= 2;
+    }
+
+    std::vector<double> nanoseconds_per_operation;
+    for (int sample = 0; sample < SAMPLES; sample++)
+    {
+        auto start = clock::now();
+        for (long long i = 0; i < batch; i++) operation();
+        auto end = clock::now();
+
+        nanoseconds_per_operation.push_back(std::chrono::duration<double, std::nano>(end - start).count() / batch);
+    }
+
+    std::sort(nanoseconds_per_operation.begin(), nanoseconds_per_operation.end());
+    double median = nanoseconds_per_operation[SAMPLES / 2];
+
+    std::printf("%s,%.3f\n", name, median);
+    return median;
+}
+
+int main()
+{
+    srand(RANDOM_SEED);
+
+    /* Paddles */
+    {
+        Paddle paddle(Paddle::INIT_POS, 0);
+        paddle.set_up();
+        measure("paddle_update_player_ns", [&] { paddle.update(DELTA_TIME); do_not_optimise(paddle); });
+
+        Paddle cpu(Paddle::INIT_POS, 0);
+        cpu.toggle_playability();
+        measure("paddle_update_cpu_ns", [&] { cpu.update(DELTA_TIME); do_not_optimise(cpu); });
+    }
+
+    /* Balls, each case restarting from the same state every call */
+    {
+        Paddle paddle(Paddle::INIT_POS, 0);
+        Ball ball;
+
+        measure("ball_update_miss_ns", [&] {
+            ball.set_position(glm::vec3(0.0f, 0.0f, 0.0f));
+            ball.set_direction(glm::vec3(1.0f, 0.0f, 0.0f));
+            do_not_optimise(ball.update(DELTA_TIME, &paddle));
+        });
+
+        measure("ball_update_hit_ns", [&] {
+            ball.set_position(glm::vec3(Paddle::INIT_POS.x - STANDARD_WIDTH - 0.01f, 0.0f, 0.0f));
+            ball.set_direction(glm::vec3(1.0f, 0.0f, 0.0f));
+            do_not_optimise(ball.update(DELTA_TIME, &paddle));
+        });
+
+        measure("ball_update_wall_ns", [&] {
+            ball.set_position(glm::vec3(0.0f, Ball::VERTICAL_BOUND - 0.01f, 0.0f));
+            ball.set_direction(glm::vec3(0.0f, 1.0f, 0.0f));
+            do_not_optimise(ball.update(DELTA_TIME, &paddle));
+        });
+    }
+
+    /* Bounds checks */
+    {
+        Paddle player_one(-Paddle::INIT_POS, 0),
+               player_two(Paddle::INIT_POS, 0);
+        Ball ball;
+
+        ball.set_position(glm::vec3(0.0f, 0.0f, 0.0f));
+        measure("ball_is_out_of_bounds_in_ns", [&] { do_not_optimise(ball.is_out_of_bounds(&player_one, &player_two)); });
+
+        ball.set_position(glm::vec3(Ball::HORIZONTAL_BOUND, 0.0f, 0.0f));
+        measure("ball_is_out_of_bounds_out_ns", [&] { do_not_optimise(ball.is_out_of_bounds(&player_one, &player_two)); });
+    }
+
+    /* Transforms */
+    {
+        Paddle player_one(-Paddle::INIT_POS, 0),
+               player_two(Paddle::INIT_POS, 0);
+        std::vector<Ball> balls(Ball::MAX_AMOUNT);
+
+        measure("ball_update_transform_ns", [&] { balls[0].update_transform(); do_not_optimise(balls[0].get_transform()); });
+        measure("update_transforms_3_balls_ns", [&] {
+            update_transforms(&player_one, &player_two, balls.data(), Ball::MAX_AMOUNT);
+            do_not_optimise(balls[Ball::MAX_AMOUNT - 1].get_transform());
+        });
+    }
+
+    /* Full ticks, with both paddles under CPU control so the matches play themselves */
+    for (int ball_count : TICK_BALL_COUNTS)
+    {
+        Paddle player_one(-Paddle::INIT_POS, 0),
+               player_two(Paddle::INIT_POS, 0);
+        player_one.toggle_playability();
+        player_two.toggle_playability();
+
+        std::vector<Ball> balls(ball_count);
+        for (Ball &ball : balls) ball.enable();
+
+        ParticleSystem particles;
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "update_match_%d_balls_ns_per_tick", ball_count);
+        double tick = measure(name, [&] {
+            update_match(DELTA_TIME, &player_one, &player_two, balls.data(), ball_count, &particles);
+            do_not_optimise(balls[0].get_transform());
+        });
+        std::printf("update_match_%d_balls_ns_per_ball,%.3f\n", ball_count, tick / ball_count);
+
+        std::snprintf(name, sizeof(name), "update_match_%d_balls_no_particles_ns_per_tick", ball_count);
+        measure(name, [&] {
+            update_match(DELTA_TIME, &player_one, &player_two, balls.data(), ball_count, nullptr);
+            do_not_optimise(balls[0].get_transform());
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * Holds the trace macros in TraceEvents.h to their budgets while a trace is
+ * being recorded, so PONG_TRACE builds can ship with them: a counter or
+ * instant event, one clock read and a store, must cost under
+ * EVENT_BUDGET_NS, and a zone, which reads the clock at its start and at
+ * its end, under ZONE_BUDGET_NS, the budget of two events.
+ *
+ * Build and run from the repository root:
+ *
+ *     c++ -std=c++17 -O2 -DPONG_TRACE -I pong bench/trace_bench.cpp -o trace_bench -lpthread
+ *     ./trace_bench
+ *
+ * Each measurement is the median of SAMPLES batches within one process, and
+ * the bench runs itself PROCESS_RUNS times (--single-run measures once) and
+ * judges the median of those, since how fast a machine is, a virtual one
+ * especially, drifts from one run to the next. The budgets leave a margin
+ * of about twice the costs measured on a VM whose clock read alone costs
+ * over 20 ns: 25-29 ns for events and 45-56 ns for zones.
+ *
+ * Prints one "name,value" line per result and exits with status 1 when the
+ * median over the runs is over budget. Rings are drained between batches,
+ * outside the timed region, so every timed event is actually stored.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TraceEvents.h"
+
+#ifndef PONG_TRACE
+#error "Build with -DPONG_TRACE, or there is nothing to measure"
+#endif
+
+constexpr int    SAMPLES         = 31,
+                 PROCESS_RUNS    = 7,
+                 BATCH           = (int) TraceRecorder::RING_CAPACITY / 2;
+constexpr double EVENT_BUDGET_NS = 50.0,
+                 ZONE_BUDGET_NS  = 2.0 * EVENT_BUDGET_NS;
+
+// Median nanoseconds per event over SAMPLES batches of BATCH events
+template<typename Operation>
+double measure(const char *name, Operation operation)
+{
+    std::vector<double> nanoseconds_per_event;
+    for (int sample = 0; sample < SAMPLES + 1; sample++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BATCH; i++) operation(i);
+        auto end = std::chrono::steady_clock::now();
+
+        TraceRecorder::get().drain();
+
+        // The first batch also registers the thread's ring
+        if (sample > 0) nanoseconds_per_event.push_back(std::chrono::duration<double, std::nano>(end - start).count() / BATCH);
+    }
+
+    std::sort(nanoseconds_per_event.begin(), nanoseconds_per_event.end());
+    double median = nanoseconds_per_event[SAMPLES / 2];
+
+    std::printf("%s,%.3f\n", name, median);
+    return median;
+}
+
+// One process's measurements, printed for the run that started it to collect
+int run_once()
+{
+    measure("trace_zone_idle_ns", [](int) { TRACE_ZONE("idle"); });
+
+    if (!TraceRecorder::get().start("/dev/null"))
+    {
+        std::fprintf(stderr, "Unable to open /dev/null for the trace\n");
+        return 1;
+    }
+
+    measure("trace_zone_ns",    [](int) { TRACE_ZONE("zone"); });
+    measure("trace_counter_ns", [](int i) { TRACE_COUNTER("counter", i); });
+    measure("trace_instant_ns", [](int) { TRACE_INSTANT("instant"); });
+
+    TraceRecorder::get().stop();
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::strcmp(argv[1], "--single-run") == 0) return run_once();
+
+    std::map<std::string, std::vector<double>> runs;
+    std::string command = std::string("\"") + argv[0] + "\" --single-run";
+    for (int run = 0; run < PROCESS_RUNS; run++)
+    {
+        FILE *output = popen(command.c_str(), "r");
+        if (output == nullptr)
+        {
+            std::fprintf(stderr, "Unable to run %s\n", argv[0]);
+            return 1;
+        }
+
+        char name[64];
+        double value;
+        while (std::fscanf(output, " %63[^,],%lf", name, &value) == 2) runs[name].push_back(value);
+
+        if (pclose(output) != 0)
+        {
+            std::fprintf(stderr, "Run %d of %s failed\n", run + 1, argv[0]);
+            return 1;
+        }
+    }
+
+    std::map<std::string, double> medians;
+    for (auto &entry : runs)
+    {
+        std::sort(entry.second.begin(), entry.second.end());
+        medians[entry.first] = entry.second[entry.second.size() / 2];
+        std::printf("%s,%.3f\n", entry.first.c_str(), medians[entry.first]);
+    }
+    std::printf("trace_event_budget_ns,%.3f\ntrace_zone_budget_ns,%.3f\n", EVENT_BUDGET_NS, ZONE_BUDGET_NS);
+
+    double zone  = medians["trace_zone_ns"],
+           event = std::max(medians["trace_counter_ns"], medians["trace_instant_ns"]);
+    bool over = false;
+    if (zone > ZONE_BUDGET_NS)
+    {
+        std::fprintf(stderr, "Trace zones are over budget: %.3f ns > %.3f ns\n", zone, ZONE_BUDGET_NS);
+        over = true;
+    }
+    if (event > EVENT_BUDGET_NS)
+    {
+        std::fprintf(stderr, "Trace events are over budget: %.3f ns > %.3f ns\n", event, EVENT_BUDGET_NS);
+        over = true;
+    }
+    return over ? 1 : 0;
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "FrameProfiler.h"
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define ALLOCATION_HAS_BACKTRACE
+#endif
+
+/**
+ * Counts heap allocations per frame and per frame phase, and remembers the
+ * call stacks they come from, to keep the game loop free of allocations.
+ *
+ * Tracking is compiled in with PONG_TRACK_ALLOCATIONS, which replaces the
+ * allocator for the whole program: on glibc malloc, calloc and realloc are
+ * interposed, which also catches operator new and C libraries like SDL and
+ * stb_image; elsewhere only operator new is replaced. Only include this
+ * from one translation unit, since the replacements are defined in it.
+ *
+ * Each thread attributes its allocations to the phase it is in, set with
+ * ALLOCATION_PHASE; anything outside one counts as "other". Frames are
+ * delimited by frame_finished() from the main loop. After a warm-up, any
+ * frame that allocates inside a frame phase breaks the steady state.
+ * Loading and evicting textures is counted as "assets" instead: a texture
+ * that becomes resident needs storage, wherever in the frame that happens.
+ * GL drivers allocate internally while drawing (llvmpipe does on every
+ * frame), so the game's own steady state is best checked with --software.
+ */
+class AllocationTracker
+{
+    public:
+        // Pseudo-phases after the frame phases
+        static constexpr int PHASE_OTHER = PHASE_COUNT,
+                             PHASE_ASSETS = PHASE_COUNT + 1, // streaming textures in and out
+                             TRACKED_PHASE_COUNT = PHASE_COUNT + 2;
+        static constexpr int WARMUP_FRAMES = 120,
+                             SITE_DEPTH = 12,
+                             MAX_SITES = 256, // a power of two
+                             REPORTED_SITES = 16;
+
+    private:
+        struct Counts
+        {
+            std::atomic<uint64_t> allocations{0},
+                                  bytes{0};
+        };
+
+        // One distinct call stack; claimed once, then only its counts change
+        struct Site
+        {
+            std::atomic<int> state{0}; // 0 free, 1 being filled in, 2 ready
+            uint64_t hash = 0;
+            void *frames[SITE_DEPTH];
+            int depth = 0,
+                phase = PHASE_OTHER;
+            Counts counts;
+        };
+
+        // Session totals, only touched by frame_finished()
+        struct PhaseTotals
+        {
+            uint64_t allocations = 0,
+                     bytes = 0,
+                     frames_allocating = 0,
+                     steady_frames_allocating = 0,
+                     max_in_frame = 0;
+        };
+
+        std::atomic<bool> tracking{false};
+        Counts frame[TRACKED_PHASE_COUNT];
+        PhaseTotals totals[TRACKED_PHASE_COUNT];
+        long long frame_count = 0;
+
+        Site sites[MAX_SITES];
+        std::atomic<uint64_t> dropped_sites{0};
+
+        static bool& is_in_hook()
+        {
+            static thread_local bool in_hook = false;
+            return in_hook;
+        }
+
+        void record_site(int phase, size_t size)
+        {
+#ifdef ALLOCATION_HAS_BACKTRACE
+            void *frames[SITE_DEPTH];
+            int depth = backtrace(frames, SITE_DEPTH);
+
+            // FNV-1a over the return addresses
+            uint64_t hash = 14695981039346656037ull;
+            for (int i = 0; i < depth; i++) hash = (hash ^ (uint64_t) (uintptr_t) frames[i]) * 1099511628211ull;
+            hash |= 1;
+
+            for (int probe = 0; probe < MAX_SITES; probe++)
+            {
+                Site &site = this->sites[(hash + probe) & (MAX_SITES - 1)];
+
+                int state = site.state.load(std::memory_order_acquire);
+                if (state == 0)
+                {
+                    if (!site.state.compare_exchange_strong(state, 1, std::memory_order_acquire)) continue;
+
+                    site.hash = hash;
+                    for (int i = 0; i < depth; i++) site.frames[i] = frames[i];
+                    site.depth = depth;
+                    site.phase = phase;
+                    site.state.store(2, std::memory_order_release);
+                }
+                else if (state != 2 || site.hash != hash) continue;
+
+                site.counts.allocations.fetch_add(1, std::memory_order_relaxed);
+                site.counts.bytes.fetch_add(size, std::memory_order_relaxed);
+                return;
+            }
+            this->dropped_sites.fetch_add(1, std::memory_order_relaxed);
+#else
+            (void) phase;
+            (void) size;
+#endif
+        }
+
+        static const char* get_phase_name(int phase)
+        {
+            if (phase < PHASE_COUNT) return FRAME_PHASE_NAMES[phase];
+            return phase == PHASE_OTHER ? "other" : "assets";
+        }
+
+    public:
+        static AllocationTracker& get()
+        {
+            static AllocationTracker tracker;
+            return tracker;
+        }
+
+        static int& get_phase()
+        {
+            static thread_local int phase = PHASE_OTHER;
+            return phase;
+        }
+
+        void start()
+        {
+#ifdef ALLOCATION_HAS_BACKTRACE
+            // The first backtrace loads the unwinder, which allocates
+            void *frames[1];
+            backtrace(frames, 1);
+#endif
+            this->tracking.store(true, std::memory_order_relaxed);
+        }
+
+        // Called by the replaced allocator for every allocation
+        void record(size_t size)
+        {
+            bool &in_hook = is_in_hook();
+            if (!this->tracking.load(std::memory_order_relaxed) || in_hook) return;
+            in_hook = true;
+
+            int phase = get_phase();
+            this->frame[phase].allocations.fetch_add(1, std::memory_order_relaxed);
+            this->frame[phase].bytes.fetch_add(size, std::memory_order_relaxed);
+            if (phase != PHASE_OTHER) this->record_site(phase, size);
+
+            in_hook = false;
+        }
+
+        // Call once per iteration of the main loop
+        void frame_finished()
+        {
+            if (!this->tracking.load(std::memory_order_relaxed)) return;
+
+            for (int phase = 0; phase < TRACKED_PHASE_COUNT; phase++)
+            {
+                uint64_t allocations = this->frame[phase].allocations.exchange(0, std::memory_order_relaxed),
+                         bytes       = this->frame[phase].bytes.exchange(0, std::memory_order_relaxed);
+                if (allocations == 0) continue;
+
+                PhaseTotals &totals = this->totals[phase];
+                totals.allocations += allocations;
+                totals.bytes += bytes;
+                totals.frames_allocating++;
+                if (this->frame_count >= WARMUP_FRAMES) totals.steady_frames_allocating++;
+                if (allocations > totals.max_in_frame) totals.max_in_frame = allocations;
+            }
+            this->frame_count++;
+        }
+
+        // Frames after the warm-up in which any phase allocated
+        uint64_t get_steady_frames_allocating() const
+        {
+            uint64_t frames = 0;
+            for (int phase = 0; phase < PHASE_COUNT; phase++) frames += this->totals[phase].steady_frames_allocating;
+            return frames;
+        }
+
+        /**
+         * Writes per-phase totals, then the call stacks that allocated
+         * inside a phase most often, symbolised as far as the executable's
+         * symbols allow (addr2line can resolve the rest).
+         *
+         * @return Whether the whole file could be written.
+         */
+        bool write(const char *filepath)
+        {
+            // Reporting allocates too
+            this->tracking.store(false, std::memory_order_relaxed);
+
+            FILE *file = std::fopen(filepath, "w");
+            if (file == nullptr) return false;
+
+            std::fprintf(file, "frames %lld, warm-up %d\n", this->frame_count, WARMUP_FRAMES);
+            std::fprintf(file, "%-8s %12s %14s %10s %10s %14s\n",
+                         "phase", "allocations", "bytes", "frames", "max/frame", "steady_frames");
+            for (int phase = 0; phase < TRACKED_PHASE_COUNT; phase++)
+            {
+                const PhaseTotals &totals = this->totals[phase];
+                std::fprintf(file, "%-8s %12llu %14llu %10llu %10llu %14llu\n", get_phase_name(phase),
+                             (unsigned long long) totals.allocations, (unsigned long long) totals.bytes,
+                             (unsigned long long) totals.frames_allocating, (unsigned long long) totals.max_in_frame,
+                             (unsigned long long) totals.steady_frames_allocating);
+            }
+
+#ifdef ALLOCATION_HAS_BACKTRACE
+            for (int reported = 0; reported < REPORTED_SITES; reported++)
+            {
+                Site *top = nullptr;
+                for (Site &site : this->sites)
+                {
+                    if (site.state.load(std::memory_order_acquire) != 2 || site.depth < 0) continue;
+                    if (top == nullptr || site.counts.allocations > top->counts.allocations) top = &site;
+                }
+                if (top == nullptr) break;
+
+                std::fprintf(file, "\nsite %d: %llu allocations, %llu bytes, in %s\n", reported + 1,
+                             (unsigned long long) top->counts.allocations, (unsigned long long) top->counts.bytes,
+                             get_phase_name(top->phase));
+                std::fflush(file);
+                backtrace_symbols_fd(top->frames, top->depth, fileno(file));
+
+                top->depth = -1; // reported
+            }
+            if (this->dropped_sites > 0)
+            {
+                std::fprintf(file, "\n%llu allocations came from sites past the first %d\n",
+                             (unsigned long long) this->dropped_sites.load(), MAX_SITES);
+            }
+#endif
+
+            return std::fclose(file) == 0;
+        }
+};
+
+// Attributes the current thread's allocations to a phase until the end of the scope
+class ScopedAllocationPhase
+{
+    private:
+        int previous;
+
+    public:
+        explicit ScopedAllocationPhase(int phase)
+            : previous(AllocationTracker::get_phase())
+        {
+            AllocationTracker::get_phase() = phase;
+        }
+
+        ~ScopedAllocationPhase()
+        {
+            AllocationTracker::get_phase() = this->previous;
+        }
+};
+
+#define ALLOCATION_CONCATENATE_INNER(a, b) a##b
+#define ALLOCATION_CONCATENATE(a, b) ALLOCATION_CONCATENATE_INNER(a, b)
+
+#ifdef PONG_TRACK_ALLOCATIONS
+#define ALLOCATION_PHASE(phase) ScopedAllocationPhase ALLOCATION_CONCATENATE(allocation_phase_, __LINE__)(phase)
+
+#ifdef __GLIBC__
+// glibc's own entry points, so the replacements below need no dlsym
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void *pointer, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    AllocationTracker::get().record(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    AllocationTracker::get().record(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void *pointer, size_t size)
+{
+    AllocationTracker::get().record(size);
+    return __libc_realloc(pointer, size);
+}
+#else
+void* operator new(size_t size)
+{
+    AllocationTracker::get().record(size);
+    void *pointer = std::malloc(size > 0 ? size : 1);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept            { std::free(pointer); }
+void operator delete[](void *pointer) noexcept          { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept    { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept  { std::free(pointer); }
+#endif
+#else
+#define ALLOCATION_PHASE(phase) ((void) 0)
+#endif
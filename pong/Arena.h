@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "pong_lib.h"
+#include "PaddlePolicy.h"
+#include "RenderList.h"
+#include "Simulation.h"
+
+// Instance shapes of one arena's court, drawn at full size, its walls and
+// its paddles, which are instanced at their height
+MATH_CONSTANT glm::vec2 ARENA_COURT_SHAPE  = glm::vec2(8.0f, 6.0f),
+                        ARENA_WALL_SHAPE   = glm::vec2(8.0f, 0.64f),
+                        ARENA_PADDLE_SHAPE = glm::vec2(Paddle::INIT_SCALE.x / Paddle::INIT_SCALE.y, 1.0f);
+MATH_CONSTANT glm::vec4 ARENA_COURT_COLOUR = glm::vec4(0.0f, 0.0f, 0.0f, 0.45f),
+                        ARENA_WALL_COLOUR  = glm::vec4(0.55f, 0.3f, 0.15f, 1.0f);
+
+constexpr float ARENA_WALL_Y      = 2.67f,
+                ARENA_SCORE_X     = 1.72f,
+                ARENA_SCORE_Y     = 1.83f,
+                ARENA_PIP_SIZE    = 0.2f,
+                ARENA_PIP_SPACING = 0.3f,
+                ARENA_CELL_FILL   = 0.94f; // of a grid cell, leaving a gap between arenas
+
+// One independent CPU-against-CPU match of the spectator grid
+struct Arena
+{
+    Paddle player_one,
+           player_two;
+    Ball balls[Ball::MAX_AMOUNT];
+    glm::vec2 offset; // of its centre, on screen
+
+    Arena()
+        : player_one(-Paddle::INIT_POS, 0),
+          player_two(Paddle::INIT_POS, 0)
+    {
+        this->player_one.toggle_playability();
+        this->player_two.toggle_playability();
+    }
+};
+
+/**
+ * Plays many matches side by side for the spectator view (--arenas N) and
+ * lays them out as a grid of tiles, each a scaled-down copy of the court.
+ *
+ * Tiles are not the game's own screen rendered into a viewport per arena:
+ * each arena is drawn as flat coloured rectangles and discs, its court,
+ * walls, paddles and balls placed into its tile and added to one instance
+ * batch per shape and colour. A viewport per arena would cost a render list
+ * and a set of textured draws per arena, so the draw count would grow with
+ * the grid, and the software renderer has no viewports; this way the whole
+ * grid costs the same six instanced draws however many arenas it holds.
+ * Scores are drawn as pips. A match that has been won starts over at once.
+ *
+ * Player two of every arena can be handed to a policy, which then decides
+ * for all of them in one batch per tick.
+ */
+class ArenaGrid
+{
+    private:
+        std::vector<Arena> arenas;
+        int columns,
+            rows;
+        float scale; // of every arena, from the full-screen court
+        int matches_finished = 0;
+
+        const PaddlePolicy *policy = nullptr; // player two's, in every arena
+        std::vector<PaddleObservation> observations;
+        std::vector<int32_t> directions;
+        uint32_t tick = 0;
+
+    public:
+        explicit ArenaGrid(int arena_count)
+            : arenas(arena_count),
+              observations(arena_count),
+              directions(arena_count)
+        {
+            // Square enough for a 4:3 screen of 4:3 courts
+            this->columns = (int) std::ceil(std::sqrt((float) arena_count));
+            this->rows    = (arena_count + this->columns - 1) / this->columns;
+            this->scale   = 1.0f / this->columns;
+
+            for (int i = 0; i < arena_count; i++)
+            {
+                int column = i % this->columns,
+                    row    = i / this->columns;
+
+                this->arenas[i].offset = glm::vec2(
+                    (column - 0.5f * (this->columns - 1)) * ARENA_COURT_SHAPE.x * this->scale,
+                    (0.5f * (this->rows - 1) - row) * ARENA_COURT_SHAPE.y * this->scale
+                );
+                this->arenas[i].balls[0].enable();
+                this->arenas[i].player_one.update_transform();
+                this->arenas[i].player_two.update_transform();
+            }
+        }
+
+        int size() const
+        {
+            return (int) this->arenas.size();
+        }
+
+        Arena& operator[](int i)
+        {
+            return this->arenas[i];
+        }
+
+        int get_matches_finished() const
+        {
+            return this->matches_finished;
+        }
+
+        // The most instances push_instances() puts in any one batch
+        int get_max_batch_instances() const
+        {
+            return this->size() * (Ball::MAX_AMOUNT + FIRST_TO_SCORE);
+        }
+
+        // Hands player two of every arena to a policy, or back to the game's CPU with nullptr
+        void set_policy(const PaddlePolicy *policy)
+        {
+            this->policy = policy;
+            for (Arena &arena : this->arenas)
+            {
+                if (arena.player_two.get_status() != (policy != nullptr && !policy->is_cpu()))
+                {
+                    arena.player_two.toggle_playability();
+                }
+            }
+        }
+
+        // Plays every arena with its first ball_count balls, each served afresh
+        void set_ball_count(int ball_count)
+        {
+            for (Arena &arena : this->arenas)
+            {
+                for (int i = 0; i < Ball::MAX_AMOUNT; i++)
+                {
+                    arena.balls[i].reset();
+                    if (i < ball_count) arena.balls[i].enable();
+                    else                arena.balls[i].disable();
+                }
+            }
+        }
+
+        void update(float delta_time)
+        {
+            if (this->policy != nullptr && !this->policy->is_cpu())
+            {
+                for (int i = 0; i < this->size(); i++)
+                {
+                    Arena &arena = this->arenas[i];
+                    this->observations[i] = observe(&arena.player_two, &arena.player_one, arena.balls, Ball::MAX_AMOUNT,
+                                                    this->tick);
+                }
+
+                decide_batch(*this->policy, this->observations.data(), this->size(), this->directions.data());
+                for (int i = 0; i < this->size(); i++) set_paddle_direction(&this->arenas[i].player_two, this->directions[i]);
+            }
+            this->tick++;
+
+            for (Arena &arena : this->arenas)
+            {
+                update_match(delta_time, &arena.player_one, &arena.player_two, arena.balls, Ball::MAX_AMOUNT, nullptr);
+
+                if (arena.player_one.check_score() || arena.player_two.check_score())
+                {
+                    arena.player_one.reset();
+                    arena.player_two.reset();
+                    for (Ball &ball : arena.balls) ball.reset();
+                    this->matches_finished++;
+                }
+            }
+            TRACE_COUNTER("matches_finished", this->matches_finished);
+        }
+
+        // Adds the batches that draw the whole grid, paddles and balls in each player's colour
+        void push_instances(RenderList &list, const glm::vec4 &player_one_colour, const glm::vec4 &player_two_colour)
+        {
+            std::vector<glm::vec4> *courts      = list.add_batch(ARENA_COURT_COLOUR, ARENA_COURT_SHAPE),
+                                   *walls       = list.add_batch(ARENA_WALL_COLOUR, ARENA_WALL_SHAPE),
+                                   *paddles_one = list.add_batch(player_one_colour, ARENA_PADDLE_SHAPE),
+                                   *paddles_two = list.add_batch(player_two_colour, ARENA_PADDLE_SHAPE),
+                                   *balls_one   = list.add_batch(player_one_colour),
+                                   *balls_two   = list.add_batch(player_two_colour);
+            if (balls_two == nullptr) return;
+
+            float arena_scale = ARENA_CELL_FILL * this->scale;
+            auto place = [arena_scale](const glm::vec2 &offset, float x, float y, float size)
+            {
+                return glm::vec4(offset.x + arena_scale * x, offset.y + arena_scale * y, arena_scale * size, 1.0f);
+            };
+
+            for (Arena &arena : this->arenas)
+            {
+                courts->push_back(place(arena.offset, 0.0f, 0.0f, 1.0f));
+                walls->push_back(place(arena.offset, 0.0f, ARENA_WALL_Y, 1.0f));
+                walls->push_back(place(arena.offset, 0.0f, -ARENA_WALL_Y, 1.0f));
+
+                const glm::vec4 &paddle_one = arena.player_one.get_transform(),
+                                &paddle_two = arena.player_two.get_transform();
+                paddles_one->push_back(place(arena.offset, paddle_one.x, paddle_one.y, paddle_one.w));
+                paddles_two->push_back(place(arena.offset, paddle_two.x, paddle_two.y, paddle_two.w));
+
+                for (Ball &ball : arena.balls)
+                {
+                    if (!ball.get_status()) continue;
+
+                    const glm::vec4 &transform = ball.get_transform();
+                    (ball.get_owner() ? balls_one : balls_two)->push_back(place(arena.offset, transform.x, transform.y,
+                                                                                transform.z));
+                }
+
+                for (int pip = 0; pip < arena.player_one.get_score(); pip++)
+                {
+                    balls_one->push_back(place(arena.offset, -ARENA_SCORE_X - pip * ARENA_PIP_SPACING, ARENA_SCORE_Y,
+                                               ARENA_PIP_SIZE));
+                }
+                for (int pip = 0; pip < arena.player_two.get_score(); pip++)
+                {
+                    balls_two->push_back(place(arena.offset, ARENA_SCORE_X + pip * ARENA_PIP_SPACING, ARENA_SCORE_Y,
+                                               ARENA_PIP_SIZE));
+                }
+            }
+        }
+};
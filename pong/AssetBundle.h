@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Asset bundle file layout, written offline by tools/bundle_assets.cpp:
+ *
+ *     AssetBundleHeader
+ *     AssetEntry[entry_count]
+ *     blobs, each starting on an ASSET_BLOB_ALIGNMENT boundary
+ *
+ * Textures are stored already decoded, as tightly packed RGBA8 rows from top
+ * to bottom, exactly as glTexImage2D and stbi_load lay them out. Shaders are
+ * stored as their source text without a terminating null. All integers are
+ * little-endian.
+ */
+constexpr char ASSET_BUNDLE_MAGIC[8] = { 'P', 'O', 'N', 'G', 'P', 'A', 'K', '\0' };
+constexpr uint32_t ASSET_BUNDLE_VERSION = 1;
+constexpr uint64_t ASSET_BLOB_ALIGNMENT = 64;
+constexpr int ASSET_NAME_LENGTH = 48;
+
+enum AssetType : uint32_t
+{
+    ASSET_TEXTURE_RGBA8,
+    ASSET_SHADER_SOURCE
+};
+
+struct AssetBundleHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+};
+
+struct AssetEntry
+{
+    char name[ASSET_NAME_LENGTH]; // the path the asset was bundled from, null-terminated
+    uint32_t type;
+    uint32_t width, height;       // zero for shaders
+    uint32_t reserved;
+    uint64_t offset, size;        // in bytes, from the start of the file
+};
+
+static_assert(sizeof(AssetBundleHeader) == 16 && sizeof(AssetEntry) == 80, "bundle layout must not depend on padding");
+
+/**
+ * Read-only view of an asset bundle. The file is memory-mapped, so opening
+ * it reads nothing up front and the pointers handed out point straight into
+ * the mapping: textures go to glTexImage2D without being copied or decoded.
+ * Pointers stay valid until the bundle is closed.
+ */
+class AssetBundle
+{
+    private:
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+        const AssetEntry *entries = nullptr;
+        uint32_t entry_count = 0;
+
+#ifdef _WINDOWS
+        std::vector<uint8_t> contents; // no mmap; the file is read in one go instead
+#endif
+
+        bool map_file(const char *filepath)
+        {
+#ifdef _WINDOWS
+            FILE *file = std::fopen(filepath, "rb");
+            if (file == nullptr) return false;
+
+            std::fseek(file, 0, SEEK_END);
+            this->contents.resize(std::ftell(file));
+            std::fseek(file, 0, SEEK_SET);
+            bool read = std::fread(this->contents.data(), 1, this->contents.size(), file) == this->contents.size();
+            std::fclose(file);
+
+            this->data = this->contents.data();
+            this->size = this->contents.size();
+            return read;
+#else
+            int file = ::open(filepath, O_RDONLY);
+            if (file < 0) return false;
+
+            struct stat status;
+            if (fstat(file, &status) != 0 || status.st_size == 0)
+            {
+                ::close(file);
+                return false;
+            }
+
+            void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            ::close(file); // the mapping keeps the file alive
+            if (mapping == MAP_FAILED) return false;
+
+            this->data = (const uint8_t*) mapping;
+            this->size = status.st_size;
+            return true;
+#endif
+        }
+
+    public:
+        ~AssetBundle()
+        {
+            this->close();
+        }
+
+        /**
+         * Maps the bundle and checks that its header and index are sound.
+         *
+         * @return Whether the bundle can be used; if not, it stays closed.
+         */
+        bool open(const char *filepath)
+        {
+            this->close();
+            if (!this->map_file(filepath)) return false;
+
+            const AssetBundleHeader *header = (const AssetBundleHeader*) this->data;
+            bool valid = this->size >= sizeof(AssetBundleHeader) &&
+                         std::memcmp(header->magic, ASSET_BUNDLE_MAGIC, sizeof(ASSET_BUNDLE_MAGIC)) == 0 &&
+                         header->version == ASSET_BUNDLE_VERSION &&
+                         header->entry_count <= (this->size - sizeof(AssetBundleHeader)) / sizeof(AssetEntry);
+
+            if (valid)
+            {
+                this->entries = (const AssetEntry*) (this->data + sizeof(AssetBundleHeader));
+                this->entry_count = header->entry_count;
+
+                for (uint32_t i = 0; i < this->entry_count && valid; i++)
+                {
+                    const AssetEntry &entry = this->entries[i];
+                    valid = entry.offset <= this->size && entry.size <= this->size - entry.offset &&
+                            std::memchr(entry.name, '\0', ASSET_NAME_LENGTH) != nullptr;
+
+                    // A texture's pixels go straight to glTexImage2D, so its size has to be
+                    // exactly what its dimensions say; the product fits in 64 bits
+                    if (valid && entry.type == ASSET_TEXTURE_RGBA8)
+                    {
+                        valid = entry.width > 0 && entry.height > 0 && entry.size % 4 == 0 &&
+                                (uint64_t) entry.width * entry.height == entry.size / 4;
+                    }
+                }
+            }
+
+            if (!valid)
+            {
+                std::fprintf(stderr, "Error: %s is not a valid asset bundle.\n", filepath);
+                this->close();
+            }
+            return valid;
+        }
+
+        void close()
+        {
+#ifdef _WINDOWS
+            this->contents.clear();
+#else
+            if (this->data != nullptr) munmap((void*) this->data, this->size);
+#endif
+            this->data = nullptr;
+            this->size = 0;
+            this->entries = nullptr;
+            this->entry_count = 0;
+        }
+
+        bool is_open() const
+        {
+            return this->data != nullptr;
+        }
+
+        // The entry bundled from the given path, or nullptr
+        const AssetEntry* find(const char *name, AssetType type) const
+        {
+            for (uint32_t i = 0; i < this->entry_count; i++)
+            {
+                const AssetEntry &entry = this->entries[i];
+                if (entry.type == type && std::strcmp(entry.name, name) == 0) return &entry;
+            }
+            return nullptr;
+        }
+
+        const uint8_t* get_data(const AssetEntry &entry) const
+        {
+            return this->data + entry.offset;
+        }
+};
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AllocationTracker.h"
+#include "AssetBundle.h"
+#include "EmbeddedAssets.h"
+#include "RenderList.h"
+#include "SoftwareRenderer.h"
+#include "StartupTracer.h"
+#include "TextureLoader.h"
+
+// Refers to one texture of an AssetManager; only the manager can make one
+struct TextureHandle
+{
+    int index = -1;
+
+    bool is_valid() const
+    {
+        return this->index >= 0;
+    }
+};
+
+/**
+ * Owns every texture and decides when each one actually occupies memory.
+ *
+ * Pixels come from the executable's embedded assets when it has them, then
+ * from the asset bundle, and only then from the texture's file.
+ *
+ * A texture's name (its GL texture name, or software renderer id) is handed
+ * out up front and never changes, so sprites can refer to it whether or not
+ * the texture is loaded. Its pixels are only decoded and uploaded the first
+ * time a render list that uses it is prepared for drawing, unless a prefetch
+ * hint already decoded them in the background.
+ *
+ * When the texture memory in use goes over the budget, textures that the
+ * list being drawn does not use are evicted, unreferenced ones first and
+ * then the least recently drawn. Eviction frees the storage but keeps the
+ * name, so an evicted texture just loads again the next time it is drawn.
+ *
+ * Textures are acquired during initialisation. After that, references are
+ * released and retained as screens stop and start drawing them, and
+ * prefetch() is called, all by the simulation, while prepare() runs on
+ * whichever thread owns the context, possibly at the same time.
+ */
+class AssetManager
+{
+    public:
+        static constexpr size_t UNLIMITED_BUDGET = 0;
+        static constexpr int MAX_PREFETCH_THREADS = 4;
+
+    private:
+        enum Residency { UNLOADED, DECODING, DECODED, RESIDENT };
+
+        struct Texture
+        {
+            std::string filepath;
+            GLuint texture_id = 0;
+            std::atomic<int> reference_count{0}; // read by eviction on the drawing thread
+            std::atomic<Residency> residency{UNLOADED}; // only changes under the lock
+
+            DecodedImage image;
+            bool owns_pixels = false; // false when they point into the bundle
+            size_t bytes = 0;
+            uint64_t last_drawn = 0;
+        };
+
+        std::vector<std::unique_ptr<Texture>> textures;
+        std::mutex mutex;
+        std::condition_variable decoded;
+
+        // Background decoding for prefetch hints, started on the first one
+        std::vector<std::thread> prefetch_threads;
+        std::deque<Texture*> prefetch_queue;
+        std::condition_variable prefetch_queued;
+        bool stopping = false;
+
+        bool names_created = false;
+        SoftwareRenderer *software_renderer = nullptr;
+        const AssetBundle *bundle = nullptr;
+        StartupTracer *tracer = nullptr;
+
+        size_t budget = UNLIMITED_BUDGET,
+               resident_bytes = 0;
+        uint64_t draw_count = 0;
+
+        // Runs without the lock; the texture is DECODING, so nothing else touches its image
+        void decode(Texture &texture)
+        {
+            const EmbeddedAsset *embedded = find_embedded_asset(texture.filepath.c_str());
+            const AssetEntry *entry = this->bundle != nullptr ? this->bundle->find(texture.filepath.c_str(), ASSET_TEXTURE_RGBA8)
+                                                              : nullptr;
+            DecodedImage image;
+            bool owns_pixels = embedded != nullptr || entry == nullptr;
+
+            if (embedded != nullptr)
+            {
+                image = decode_image_memory(embedded->data, embedded->size, texture.filepath.c_str(), this->tracer);
+            }
+            else if (entry != nullptr)
+            {
+                image.width  = entry->width;
+                image.height = entry->height;
+                image.pixels = this->bundle->get_data(*entry);
+            }
+            else
+            {
+                image = decode_image_file(texture.filepath.c_str(), this->tracer);
+            }
+
+            if (image.pixels == nullptr)
+            {
+                std::cerr << "Error: unable to load image " << texture.filepath << ". Make sure the path is correct.\n";
+            }
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            texture.image = image;
+            texture.owns_pixels = owns_pixels;
+            texture.residency = DECODED;
+            this->decoded.notify_all();
+        }
+
+        void run_prefetches()
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (true)
+            {
+                this->prefetch_queued.wait(lock, [this] { return this->stopping || !this->prefetch_queue.empty(); });
+                if (this->stopping) return;
+
+                Texture *texture = this->prefetch_queue.front();
+                this->prefetch_queue.pop_front();
+
+                lock.unlock();
+                this->decode(*texture);
+                lock.lock();
+            }
+        }
+
+        void free_pixels(Texture &texture)
+        {
+            if (texture.owns_pixels) stbi_image_free((void*) texture.image.pixels);
+            texture.image = DecodedImage();
+            texture.owns_pixels = false;
+        }
+
+        void create_name(Texture &texture)
+        {
+            if (this->software_renderer != nullptr) texture.texture_id = this->software_renderer->reserve_texture();
+            else                                    glGenTextures(1, &texture.texture_id);
+        }
+
+        void make_resident(Texture &texture)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (texture.residency == RESIDENT) return;
+
+            if (texture.residency == UNLOADED)
+            {
+                texture.residency = DECODING;
+                lock.unlock();
+                this->decode(texture);
+                lock.lock();
+            }
+            this->decoded.wait(lock, [&texture] { return texture.residency == DECODED; });
+            lock.unlock();
+
+            const DecodedImage &image = texture.image;
+            {
+                ALLOCATION_PHASE(AllocationTracker::PHASE_ASSETS);
+                ScopedStartupSpan span(this->tracer, "upload", texture.filepath.c_str());
+                span.set_bytes((long long) image.width * image.height * 4);
+
+                if (this->software_renderer != nullptr)
+                {
+                    if (image.pixels != nullptr) this->software_renderer->set_texture(texture.texture_id, image.width, image.height, image.pixels);
+                }
+                else
+                {
+                    // Only the CPU side of the upload; the driver may finish the copy later
+                    glBindTexture(GL_TEXTURE_2D, texture.texture_id);
+                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0,
+                                 GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                }
+            }
+
+            lock.lock();
+            texture.bytes = (size_t) image.width * image.height * 4;
+            this->free_pixels(texture);
+            texture.residency = RESIDENT;
+            this->resident_bytes += texture.bytes;
+        }
+
+        void evict(Texture &texture)
+        {
+            ALLOCATION_PHASE(AllocationTracker::PHASE_ASSETS);
+            if (this->software_renderer != nullptr)
+            {
+                this->software_renderer->release_texture(texture.texture_id);
+            }
+            else
+            {
+                // Zero-sized storage frees the memory but keeps the name valid
+                glBindTexture(GL_TEXTURE_2D, texture.texture_id);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            }
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->resident_bytes -= texture.bytes;
+            texture.bytes = 0;
+            texture.residency = UNLOADED;
+        }
+
+        // Evicts until back under budget, never touching what this draw uses
+        void enforce_budget()
+        {
+            while (this->budget != UNLIMITED_BUDGET && this->get_resident_bytes() > this->budget)
+            {
+                // Only this thread makes textures resident, so the candidates cannot change under it
+                Texture *victim = nullptr;
+                for (const std::unique_ptr<Texture> &texture : this->textures)
+                {
+                    if (texture->residency != RESIDENT || texture->last_drawn == this->draw_count) continue;
+
+                    if (victim == nullptr ||
+                        (texture->reference_count == 0) > (victim->reference_count == 0) ||
+                        ((texture->reference_count == 0) == (victim->reference_count == 0) &&
+                         texture->last_drawn < victim->last_drawn))
+                    {
+                        victim = texture.get();
+                    }
+                }
+
+                if (victim == nullptr) return; // the current draw alone is over budget
+                this->evict(*victim);
+            }
+        }
+
+        Texture* find(GLuint texture_id)
+        {
+            for (const std::unique_ptr<Texture> &texture : this->textures)
+            {
+                if (texture->texture_id == texture_id) return texture.get();
+            }
+            return nullptr;
+        }
+
+    public:
+        ~AssetManager()
+        {
+            this->stop_prefetching();
+            for (const std::unique_ptr<Texture> &texture : this->textures) this->free_pixels(*texture);
+        }
+
+        // Joins the prefetch threads, dropping whatever they have not started on
+        void stop_prefetching()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stopping = true;
+            }
+            this->prefetch_queued.notify_all();
+
+            for (std::thread &thread : this->prefetch_threads) thread.join();
+            this->prefetch_threads.clear();
+        }
+
+        // Where bundled textures come from; anything else is decoded from its file
+        void set_bundle(const AssetBundle *bundle)
+        {
+            this->bundle = bundle;
+        }
+
+        void set_tracer(StartupTracer *tracer)
+        {
+            this->tracer = tracer;
+        }
+
+        // In bytes of decoded texture memory; UNLIMITED_BUDGET turns eviction off
+        void set_budget(size_t budget)
+        {
+            this->budget = budget;
+        }
+
+        /**
+         * Creates names for every texture acquired so far, and for later ones
+         * as soon as they are acquired. Call once a GL context, or the given
+         * software renderer, exists.
+         */
+        void create_texture_names(SoftwareRenderer *software_renderer)
+        {
+            this->software_renderer = software_renderer;
+            this->names_created = true;
+
+            for (const std::unique_ptr<Texture> &texture : this->textures) this->create_name(*texture);
+        }
+
+        /**
+         * Returns the texture loaded from the given file, registering it on
+         * first use, and takes a reference to it. Nothing is loaded yet.
+         */
+        TextureHandle acquire(const char *filepath)
+        {
+            for (size_t i = 0; i < this->textures.size(); i++)
+            {
+                if (this->textures[i]->filepath == filepath)
+                {
+                    this->textures[i]->reference_count++;
+                    return { (int) i };
+                }
+            }
+
+            std::unique_ptr<Texture> texture(new Texture());
+            texture->filepath = filepath;
+            texture->reference_count = 1;
+            if (this->names_created) this->create_name(*texture);
+
+            this->textures.push_back(std::move(texture));
+            return { (int) this->textures.size() - 1 };
+        }
+
+        // Takes another reference to a texture already acquired
+        void retain(TextureHandle handle)
+        {
+            this->textures[handle.index]->reference_count++;
+        }
+
+        // Unreferenced textures stay loaded, but are the first to be evicted
+        void release(TextureHandle handle)
+        {
+            if (this->textures[handle.index]->reference_count > 0) this->textures[handle.index]->reference_count--;
+        }
+
+        GLuint get_texture_id(TextureHandle handle) const
+        {
+            return this->textures[handle.index]->texture_id;
+        }
+
+        /**
+         * Hint that a texture will be drawn soon: decodes it on a background
+         * thread so drawing it only has to upload. Does nothing if it is
+         * already loaded or on its way.
+         */
+        void prefetch(TextureHandle handle)
+        {
+            Texture &texture = *this->textures[handle.index];
+            if (texture.residency != UNLOADED) return;
+
+            ALLOCATION_PHASE(AllocationTracker::PHASE_ASSETS);
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (texture.residency != UNLOADED) return;
+                texture.residency = DECODING;
+                this->prefetch_queue.push_back(&texture);
+
+                // One more worker per queued texture, so a startup batch decodes in parallel
+                int thread_count = std::min(MAX_PREFETCH_THREADS, (int) std::max(1u, std::thread::hardware_concurrency()));
+                if ((int) this->prefetch_threads.size() < thread_count)
+                {
+                    this->prefetch_threads.emplace_back(&AssetManager::run_prefetches, this);
+                }
+            }
+            this->prefetch_queued.notify_one();
+        }
+
+        /**
+         * Loads every texture the list uses that is not loaded yet, then
+         * evicts down to the budget. Call right before drawing the list.
+         */
+        void prepare(const RenderList &list)
+        {
+            this->draw_count++;
+
+            for (int i = 0; i < list.size(); i++)
+            {
+                Texture *texture = this->find(list[i].texture_id);
+                if (texture == nullptr) continue;
+
+                texture->last_drawn = this->draw_count;
+                if (texture->residency != RESIDENT) this->make_resident(*texture);
+            }
+
+            this->enforce_budget();
+        }
+
+        size_t get_resident_bytes()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->resident_bytes;
+        }
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "pong_lib.h"
+
+// Refers to one ball in a BallPool for as long as it lives; the default one refers to none
+struct BallHandle
+{
+    uint32_t slot = 0,
+             generation = 0;
+};
+
+/**
+ * Runtime-sized pool of live balls, for chaos mode's thousands of them.
+ *
+ * Live balls are kept packed at the front of one array, so stepping them is
+ * a linear walk. Each sits in a slot that hands out a handle: despawning a
+ * ball moves the last one into its place, recycles its slot through a free
+ * list and bumps the slot's generation, so spawning and despawning are
+ * O(1) and a stale handle finds nothing instead of whichever ball took the
+ * slot over. Storage is reserved up front, so neither ever allocates.
+ */
+class BallPool
+{
+    private:
+        struct Slot
+        {
+            uint32_t index,      // into balls while the slot is in use
+                     generation; // starts at 1, so no live ball has the default handle
+        };
+
+        int capacity;
+        std::vector<Ball> balls;
+        std::vector<uint32_t> ball_slots; // per ball, the slot it sits in
+        std::vector<Slot> slots;
+        std::vector<uint32_t> free_slots;
+
+    public:
+        explicit BallPool(int capacity)
+            : capacity(capacity)
+        {
+            this->balls.reserve(capacity);
+            this->ball_slots.reserve(capacity);
+            this->slots.assign(capacity, { 0, 1 });
+
+            this->free_slots.reserve(capacity);
+            for (int slot = capacity - 1; slot >= 0; slot--) this->free_slots.push_back(slot);
+        }
+
+        int get_capacity() const
+        {
+            return this->capacity;
+        }
+
+        int get_live_count() const
+        {
+            return (int) this->balls.size();
+        }
+
+        // The i-th live ball; any despawn may move another ball into its place
+        Ball& operator[](int i)
+        {
+            return this->balls[i];
+        }
+
+        // The live balls, packed
+        Ball* get_balls()
+        {
+            return this->balls.data();
+        }
+
+        BallHandle get_handle(int i) const
+        {
+            uint32_t slot = this->ball_slots[i];
+            return { slot, this->slots[slot].generation };
+        }
+
+        // The ball a handle refers to, or nullptr once it has been despawned
+        Ball* get(BallHandle handle)
+        {
+            if (handle.slot >= this->slots.size()) return nullptr;
+
+            const Slot &slot = this->slots[handle.slot];
+            if (slot.generation != handle.generation) return nullptr;
+            return &this->balls[slot.index];
+        }
+
+        /**
+         * Adds a copy of a ball, enabled, at the end of the live balls.
+         *
+         * @return Its handle, or the default one when the pool is full.
+         */
+        BallHandle spawn(const Ball &ball)
+        {
+            if (this->free_slots.empty()) return {};
+
+            uint32_t slot = this->free_slots.back();
+            this->free_slots.pop_back();
+
+            this->slots[slot].index = (uint32_t) this->balls.size();
+            this->balls.push_back(ball);
+            this->balls.back().enable();
+            this->ball_slots.push_back(slot);
+
+            return { slot, this->slots[slot].generation };
+        }
+
+        // Removes the i-th live ball, moving the last live ball into its place
+        void despawn_at(int i)
+        {
+            uint32_t slot = this->ball_slots[i];
+            int last = (int) this->balls.size() - 1;
+
+            if (i != last)
+            {
+                this->balls[i] = this->balls[last];
+                this->ball_slots[i] = this->ball_slots[last];
+                this->slots[this->ball_slots[i]].index = i;
+            }
+            this->balls.pop_back();
+            this->ball_slots.pop_back();
+
+            this->slots[slot].generation++;
+            this->free_slots.push_back(slot);
+        }
+
+        // Does nothing for a handle whose ball is already gone
+        void despawn(BallHandle handle)
+        {
+            if (this->get(handle) != nullptr) this->despawn_at(this->slots[handle.slot].index);
+        }
+
+        void clear()
+        {
+            while (!this->balls.empty()) this->despawn_at((int) this->balls.size() - 1);
+        }
+};
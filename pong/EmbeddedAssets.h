@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+/**
+ * Assets compiled into the executable, so loading them needs no filesystem
+ * access and does not depend on the working directory.
+ *
+ * Embedding is opt-in: generate embedded_assets.inc with
+ * tools/embed_assets.cpp, then build with PONG_EMBED_ASSETS defined. From
+ * the repository root:
+ *
+ *     c++ -std=c++17 -O2 tools/embed_assets.cpp -o embed_assets
+ *     cd pong && ../embed_assets embedded_assets.inc $(find content shaders -name '*.png' -o -name '*.glsl')
+ *
+ * The Xcode project does both in its Embed Assets phase, writing the
+ * generated file to the target's derived sources.
+ *
+ * Without it, find_embedded_asset() finds nothing and everything is loaded
+ * from the bundle or from files as usual. Only include this from one
+ * translation unit, since the embedded arrays are defined in it.
+ */
+struct EmbeddedAsset
+{
+    const char *name; // the path the asset was embedded from
+    const unsigned char *data;
+    size_t size;      // in bytes, not counting the null that follows the data
+};
+
+#ifdef PONG_EMBED_ASSETS
+#include "embedded_assets.inc"
+#endif
+
+// The asset embedded from the given path, or nullptr
+inline const EmbeddedAsset* find_embedded_asset(const char *name)
+{
+#ifdef PONG_EMBED_ASSETS
+    for (const EmbeddedAsset &asset : EMBEDDED_ASSETS)
+    {
+        if (std::strcmp(asset.name, name) == 0) return &asset;
+    }
+#else
+    (void) name;
+#endif
+    return nullptr;
+}
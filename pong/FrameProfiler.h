@@ -0,0 +1,366 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef __APPLE__
+// The legacy 2.1 profile only exposes timer queries through the EXT entry points
+#define GL_TIME_ELAPSED        GL_TIME_ELAPSED_EXT
+#define glGetQueryObjectui64v  glGetQueryObjectui64vEXT
+#endif
+
+enum FramePhase
+{
+    PHASE_INPUT,
+    PHASE_UPDATE,
+    PHASE_RENDER,
+    PHASE_SWAP,
+    PHASE_GPU,
+    PHASE_FRAME, // from one presented frame to the next
+    PHASE_COUNT
+};
+
+constexpr const char *FRAME_PHASE_NAMES[PHASE_COUNT] = { "input", "update", "render", "swap", "gpu", "frame" };
+
+// A frame that takes longer than this misses a 60 Hz refresh
+constexpr double FRAME_BUDGET_MS = 1000.0 / 60.0;
+
+/**
+ * Statistics over the most recent WINDOW samples of one phase, plus
+ * session-wide totals. All times are in milliseconds.
+ */
+class RollingStats
+{
+    public:
+        static constexpr int WINDOW = 240;
+
+    private:
+        double samples[WINDOW];
+        int next = 0,
+            window_count = 0;
+
+        long long total_count = 0;
+        double total_sum = 0.0,
+               total_max = 0.0;
+
+    public:
+        void add(double value)
+        {
+            this->samples[this->next] = value;
+            this->next = (this->next + 1) % WINDOW;
+            this->window_count = std::min(this->window_count + 1, WINDOW);
+
+            this->total_count++;
+            this->total_sum += value;
+            this->total_max = std::max(this->total_max, value);
+        }
+
+        int get_window_count() const         { return this->window_count; }
+        long long get_total_count() const    { return this->total_count; }
+        double get_total_mean() const        { return this->total_count ? this->total_sum / this->total_count : 0.0; }
+        double get_total_max() const         { return this->total_max; }
+
+        double get_last() const
+        {
+            return this->window_count ? this->samples[(this->next + WINDOW - 1) % WINDOW] : 0.0;
+        }
+
+        double get_mean() const
+        {
+            double sum = 0.0;
+            for (int i = 0; i < this->window_count; i++) sum += this->samples[i];
+            return this->window_count ? sum / this->window_count : 0.0;
+        }
+
+        double get_min() const
+        {
+            if (this->window_count == 0) return 0.0;
+            return *std::min_element(this->samples, this->samples + this->window_count);
+        }
+
+        double get_max() const
+        {
+            if (this->window_count == 0) return 0.0;
+            return *std::max_element(this->samples, this->samples + this->window_count);
+        }
+};
+
+/**
+ * Distribution of one phase's times over the whole session, in fixed memory.
+ *
+ * Samples are counted in microsecond buckets: exact below 16 us, then
+ * SUB_BUCKETS per power of two, so every bucket is within 12.5% of the
+ * values it holds and a few hundred buckets cover up to ~16 s. Anything
+ * longer lands in the last bucket; the maximum is kept exactly.
+ *
+ * Only one thread may record, but any thread may read at the same time;
+ * counters are relaxed atomics, so reads are merely a little stale.
+ */
+class LogHistogram
+{
+    public:
+        static constexpr int LINEAR_BUCKETS = 16,
+                             SUB_BUCKET_BITS = 3,
+                             SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+                             MAX_EXPONENT = 24,
+                             BUCKET_COUNT = LINEAR_BUCKETS + (MAX_EXPONENT - 3) * SUB_BUCKETS;
+
+    private:
+        std::atomic<uint32_t> buckets[BUCKET_COUNT] = {};
+        std::atomic<uint64_t> count{0},
+                              over_budget{0},
+                              max_us{0};
+
+        static int get_bucket(uint64_t us)
+        {
+            if (us < LINEAR_BUCKETS) return (int) us;
+
+            int exponent = std::ilogb((double) us);
+            if (exponent > MAX_EXPONENT) return BUCKET_COUNT - 1;
+
+            int sub_bucket = (int) (us >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+            return LINEAR_BUCKETS + (exponent - 4) * SUB_BUCKETS + sub_bucket;
+        }
+
+        // Midpoint of the values a bucket holds, in microseconds
+        static double get_bucket_value(int bucket)
+        {
+            if (bucket < LINEAR_BUCKETS) return bucket + 0.5;
+
+            int exponent = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 4,
+                sub_bucket = (bucket - LINEAR_BUCKETS) % SUB_BUCKETS;
+            double width = (double) (1ull << (exponent - SUB_BUCKET_BITS));
+            return (SUB_BUCKETS + sub_bucket) * width + 0.5 * width;
+        }
+
+        // Single writer, so a plain load and store is enough and avoids a locked instruction
+        static void increment(std::atomic<uint64_t> &counter)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+    public:
+        void add(double milliseconds)
+        {
+            uint64_t us = (uint64_t) std::max(0.0, milliseconds * 1000.0);
+
+            std::atomic<uint32_t> &bucket = this->buckets[get_bucket(us)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+            increment(this->count);
+            if (milliseconds > FRAME_BUDGET_MS) increment(this->over_budget);
+            if (us > this->max_us.load(std::memory_order_relaxed)) this->max_us.store(us, std::memory_order_relaxed);
+        }
+
+        uint64_t get_count() const        { return this->count.load(std::memory_order_relaxed); }
+        uint64_t get_over_budget() const  { return this->over_budget.load(std::memory_order_relaxed); }
+        double get_max() const            { return this->max_us.load(std::memory_order_relaxed) / 1000.0; }
+
+        // The value below which the given fraction of samples fall, in milliseconds
+        double get_percentile(double fraction) const
+        {
+            uint64_t total = this->get_count();
+            if (total == 0) return 0.0;
+
+            uint64_t rank = (uint64_t) std::ceil(fraction * total),
+                     seen = 0;
+            for (int i = 0; i < BUCKET_COUNT; i++)
+            {
+                seen += this->buckets[i].load(std::memory_order_relaxed);
+                if (seen >= rank && seen > 0) return std::min(get_bucket_value(i) / 1000.0, this->get_max());
+            }
+            return this->get_max();
+        }
+};
+
+/**
+ * Per-phase frame timings. CPU phases are measured with ScopedCpuTimer and
+ * GPU time is fed in by GpuTimer. Each phase must only be recorded from one
+ * thread.
+ *
+ * Every phase keeps both rolling statistics over recent frames and a
+ * histogram of the whole session for its tail percentiles.
+ */
+class FrameProfiler
+{
+    private:
+        RollingStats phases[PHASE_COUNT];
+        LogHistogram histograms[PHASE_COUNT];
+        std::chrono::steady_clock::time_point last_frame;
+        bool has_last_frame = false;
+
+    public:
+        void record(FramePhase phase, double milliseconds)
+        {
+            this->phases[phase].add(milliseconds);
+            this->histograms[phase].add(milliseconds);
+        }
+
+        // Call once per presented frame, always from the same thread
+        void frame_presented()
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (this->has_last_frame)
+            {
+                this->record(PHASE_FRAME, std::chrono::duration<double, std::milli>(now - this->last_frame).count());
+            }
+            this->last_frame = now;
+            this->has_last_frame = true;
+        }
+
+        const LogHistogram& get_histogram(FramePhase phase) const
+        {
+            return this->histograms[phase];
+        }
+
+        /**
+         * Writes one line per phase with its session percentiles, maximum
+         * and how many samples went over FRAME_BUDGET_MS. Safe to call while
+         * other threads are recording.
+         *
+         * @return Whether the whole file could be written.
+         */
+        bool write_histograms(const char *filepath) const
+        {
+            FILE *file = std::fopen(filepath, "w");
+            if (file == nullptr) return false;
+
+            std::fprintf(file, "%-8s %10s %10s %10s %10s %10s %10s %12s\n",
+                         "phase", "samples", "p50_ms", "p90_ms", "p99_ms", "p99.9_ms", "max_ms", "over_budget");
+
+            for (int i = 0; i < PHASE_COUNT; i++)
+            {
+                const LogHistogram &histogram = this->histograms[i];
+                std::fprintf(file, "%-8s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f %12llu\n",
+                             FRAME_PHASE_NAMES[i], (unsigned long long) histogram.get_count(),
+                             histogram.get_percentile(0.5), histogram.get_percentile(0.9),
+                             histogram.get_percentile(0.99), histogram.get_percentile(0.999),
+                             histogram.get_max(), (unsigned long long) histogram.get_over_budget());
+            }
+            std::fprintf(file, "budget_ms %.3f\n", FRAME_BUDGET_MS);
+
+            return std::fclose(file) == 0;
+        }
+
+        const RollingStats& get_stats(FramePhase phase) const
+        {
+            return this->phases[phase];
+        }
+
+        /**
+         * Writes one line per phase with its windowed and session statistics.
+         *
+         * @return Whether the whole file could be written.
+         */
+        bool write(const char *filepath) const
+        {
+            FILE *file = std::fopen(filepath, "w");
+            if (file == nullptr) return false;
+
+            std::fprintf(file, "%-8s %8s %10s %10s %10s %10s %12s %12s\n",
+                         "phase", "samples", "last_ms", "mean_ms", "min_ms", "max_ms",
+                         "session_mean", "session_max");
+
+            for (int i = 0; i < PHASE_COUNT; i++)
+            {
+                const RollingStats &stats = this->phases[i];
+                // The session mean is precise enough to compare sub-microsecond phases between runs
+                std::fprintf(file, "%-8s %8lld %10.3f %10.3f %10.3f %10.3f %12.6f %12.3f\n",
+                             FRAME_PHASE_NAMES[i], stats.get_total_count(), stats.get_last(),
+                             stats.get_mean(), stats.get_min(), stats.get_max(),
+                             stats.get_total_mean(), stats.get_total_max());
+            }
+
+            return std::fclose(file) == 0;
+        }
+};
+
+// Records the CPU time between construction and destruction as one phase sample
+class ScopedCpuTimer
+{
+    private:
+        FrameProfiler &profiler;
+        FramePhase phase;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        ScopedCpuTimer(FrameProfiler &profiler, FramePhase phase)
+            : profiler(profiler), phase(phase), start(std::chrono::steady_clock::now()) {}
+
+        ~ScopedCpuTimer()
+        {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - this->start;
+            this->profiler.record(this->phase, elapsed.count());
+        }
+};
+
+/**
+ * Measures the GPU time of each frame with GL_TIME_ELAPSED queries.
+ *
+ * Queries are kept in a ring and only read once GL reports their result
+ * available, so reading never stalls the pipeline. If the GPU falls so far
+ * behind that the whole ring is still pending, that frame goes unmeasured
+ * instead. The first RING_SIZE results are dropped: they cover driver and
+ * shader warm-up, and some drivers (llvmpipe) report garbage for the very
+ * first query.
+ */
+class GpuTimer
+{
+    public:
+        static constexpr int RING_SIZE = 4;
+
+    private:
+        GLuint query_ids[RING_SIZE];
+        bool pending[RING_SIZE] = {};
+        int next = 0,
+            oldest = 0,
+            warmup_results = RING_SIZE;
+        bool active = false;
+
+    public:
+        void initialise()
+        {
+            glGenQueries(RING_SIZE, this->query_ids);
+        }
+
+        // Hands every finished query to the profiler, oldest first
+        void collect(FrameProfiler &profiler)
+        {
+            while (this->pending[this->oldest])
+            {
+                GLint available = 0;
+                glGetQueryObjectiv(this->query_ids[this->oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) break;
+
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(this->query_ids[this->oldest], GL_QUERY_RESULT, &nanoseconds);
+                if (this->warmup_results > 0) this->warmup_results--;
+                else                          profiler.record(PHASE_GPU, nanoseconds / 1.0e6);
+
+                this->pending[this->oldest] = false;
+                this->oldest = (this->oldest + 1) % RING_SIZE;
+            }
+        }
+
+        void begin(FrameProfiler &profiler)
+        {
+            this->collect(profiler);
+
+            this->active = !this->pending[this->next];
+            if (this->active) glBeginQuery(GL_TIME_ELAPSED, this->query_ids[this->next]);
+        }
+
+        void end()
+        {
+            if (!this->active) return;
+
+            glEndQuery(GL_TIME_ELAPSED);
+            this->pending[this->next] = true;
+            this->next = (this->next + 1) % RING_SIZE;
+            this->active = false;
+        }
+};
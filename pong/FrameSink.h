@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+/**
+ * Receives one finished frame. Pixels are tightly packed RGBA8 rows; when
+ * bottom_up is set the first row is the bottom of the image, as returned by
+ * glReadPixels.
+ */
+using FrameSink = std::function<void(const uint8_t *rgba, int width, int height,
+                                     bool bottom_up, int frame_index)>;
+
+/**
+ * Writes RGBA8 pixels as a binary PPM, dropping the alpha channel.
+ *
+ * @return Whether the whole file could be written.
+ */
+inline bool write_ppm(const char *filepath, const uint8_t *rgba, int width, int height, bool bottom_up)
+{
+    FILE *file = std::fopen(filepath, "wb");
+    if (file == nullptr) return false;
+
+    std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    std::vector<unsigned char> row((size_t) width * 3);
+    bool success = true;
+    for (int y = 0; y < height && success; y++)
+    {
+        const uint8_t *pixels = rgba + (size_t) (bottom_up ? height - 1 - y : y) * width * 4;
+        for (int x = 0; x < width; x++)
+        {
+            row[x * 3]     = pixels[x * 4];
+            row[x * 3 + 1] = pixels[x * 4 + 1];
+            row[x * 3 + 2] = pixels[x * 4 + 2];
+        }
+        success = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+
+    return std::fclose(file) == 0 && success;
+}
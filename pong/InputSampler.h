@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Hands keyboard input from the thread that samples it to the simulation,
+ * without either ever waiting on the other.
+ *
+ * The sampling thread pushes each key event, stamped when it was sampled,
+ * onto a single-producer single-consumer ring, then publishes the keys held
+ * as of that sample together with how far the ring had got, as one word.
+ * Once per step the simulation takes the newest sample, pops the events up
+ * to it to place each change within the step, and then trusts the sample's
+ * held keys for anything the ring had no room for. Held key bits are
+ * whatever the caller makes them, at most 32 keys.
+ */
+class InputSampler
+{
+    public:
+        static constexpr uint32_t RING_CAPACITY = 256; // a power of two
+
+        struct KeyEvent
+        {
+            uint32_t timestamp; // milliseconds, on the caller's clock
+            int32_t scancode,
+                    keycode;
+            bool down;
+        };
+
+    private:
+        KeyEvent events[RING_CAPACITY];
+        std::atomic<uint32_t> head{0},
+                              tail{0};
+        std::atomic<uint64_t> sample{0}; // ring head in the high half, held keys in the low
+        uint32_t read_end = 0;           // the simulation's sample's ring head
+
+    public:
+        // Sampling thread: false if the simulation has fallen RING_CAPACITY events behind
+        bool push(const KeyEvent &event)
+        {
+            uint32_t head = this->head.load(std::memory_order_relaxed);
+            if (head - this->tail.load(std::memory_order_acquire) == RING_CAPACITY) return false;
+
+            this->events[head & (RING_CAPACITY - 1)] = event;
+            this->head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Sampling thread: call once per sample, after pushing its events
+        void publish(uint32_t held_keys)
+        {
+            uint64_t head = this->head.load(std::memory_order_relaxed);
+            this->sample.store(head << 32 | held_keys, std::memory_order_release);
+        }
+
+        // Simulation: takes the newest sample and returns its held keys
+        uint32_t read_sample()
+        {
+            uint64_t sample = this->sample.load(std::memory_order_acquire);
+            this->read_end = (uint32_t) (sample >> 32);
+            return (uint32_t) sample;
+        }
+
+        // Simulation: false once every event up to the sample read has been taken
+        bool pop(KeyEvent &event)
+        {
+            uint32_t tail = this->tail.load(std::memory_order_relaxed);
+            if (tail == this->read_end) return false;
+
+            event = this->events[tail & (RING_CAPACITY - 1)];
+            this->tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+};
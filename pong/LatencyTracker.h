@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "FrameProfiler.h"
+
+enum LatencyStage
+{
+    STAGE_POLL,    // key event to process_input() picking it up
+    STAGE_UPDATE,  // to the update() that moved the paddle with it
+    STAGE_RENDER,  // to the end of drawing the first frame that shows it
+    STAGE_PRESENT, // to that frame being swapped to the screen
+    STAGE_TOTAL,   // from the key event to the swap
+    STAGE_COUNT
+};
+
+constexpr const char *LATENCY_STAGE_NAMES[STAGE_COUNT] = { "poll", "update", "render", "present", "total" };
+
+/**
+ * Follows every paddle input from its key event to the swap of the first
+ * frame that shows it, and keeps a histogram of each stage's latency.
+ *
+ * Inputs are numbered as they are polled. Each render list carries the
+ * number of the newest input applied before it was built, so the thread
+ * that draws and presents, whichever it is, can tell which inputs a frame
+ * is the first to show. Polling and updating must happen on one thread,
+ * drawing and presenting on one thread, possibly another.
+ *
+ * SDL stamps key events in whole milliseconds, so the poll stage is only
+ * that precise; every later stage uses the steady clock.
+ */
+class LatencyTracker
+{
+    public:
+        static constexpr int MAX_PENDING = 256; // inputs in flight at once, a power of two
+
+    private:
+        struct Probe
+        {
+            double event_ms, polled_ms, applied_ms, drawn_ms;
+        };
+
+        bool enabled = false;
+        std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+        Probe probes[MAX_PENDING];
+        uint32_t next_sequence = 1,                // only touched while polling
+                 drawn_sequence = 0;               // only touched while drawing
+        std::atomic<uint32_t> applied_sequence{0},
+                              presented_sequence{0};
+
+        LogHistogram histograms[STAGE_COUNT];
+
+        Probe& get_probe(uint32_t sequence)
+        {
+            return this->probes[sequence & (MAX_PENDING - 1)];
+        }
+
+    public:
+        // Milliseconds on the clock every stage is measured with
+        double now_ms() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->origin).count();
+        }
+
+        void set_enabled(bool enabled)
+        {
+            this->enabled = enabled;
+        }
+
+        bool is_enabled() const
+        {
+            return this->enabled;
+        }
+
+        /**
+         * Starts following an input that process_input() just picked up. It
+         * is dropped if MAX_PENDING inputs are already waiting to be shown.
+         *
+         * @param event_ms When the key event happened, by now_ms().
+         */
+        void input_polled(double event_ms)
+        {
+            if (!this->enabled) return;
+            if (this->next_sequence - this->presented_sequence.load(std::memory_order_acquire) > MAX_PENDING) return;
+
+            this->get_probe(this->next_sequence++) = { event_ms, this->now_ms(), 0.0, 0.0 };
+        }
+
+        // Call after update() has applied every input polled so far
+        void inputs_applied()
+        {
+            if (!this->enabled) return;
+
+            double now = this->now_ms();
+            uint32_t applied = this->applied_sequence.load(std::memory_order_relaxed);
+            for (uint32_t sequence = applied + 1; sequence < this->next_sequence; sequence++)
+            {
+                this->get_probe(sequence).applied_ms = now;
+            }
+            this->applied_sequence.store(this->next_sequence - 1, std::memory_order_release);
+        }
+
+        // The newest input applied so far, for the next render list to carry
+        uint32_t get_applied_sequence() const
+        {
+            return this->applied_sequence.load(std::memory_order_acquire);
+        }
+
+        // Call once a frame is drawn, with the input sequence of its render list
+        void frame_drawn(uint32_t sequence)
+        {
+            if (!this->enabled) return;
+
+            double now = this->now_ms();
+            for (; this->drawn_sequence < sequence; this->drawn_sequence++)
+            {
+                this->get_probe(this->drawn_sequence + 1).drawn_ms = now;
+            }
+        }
+
+        // Call once the frame last drawn is on its way to the screen
+        void frame_presented()
+        {
+            if (!this->enabled) return;
+
+            double now = this->now_ms();
+            uint32_t presented = this->presented_sequence.load(std::memory_order_relaxed);
+            for (uint32_t sequence = presented + 1; sequence <= this->drawn_sequence; sequence++)
+            {
+                const Probe &probe = this->get_probe(sequence);
+                this->histograms[STAGE_POLL].add(probe.polled_ms - probe.event_ms);
+                this->histograms[STAGE_UPDATE].add(probe.applied_ms - probe.polled_ms);
+                this->histograms[STAGE_RENDER].add(probe.drawn_ms - probe.applied_ms);
+                this->histograms[STAGE_PRESENT].add(now - probe.drawn_ms);
+                this->histograms[STAGE_TOTAL].add(now - probe.event_ms);
+            }
+            this->presented_sequence.store(this->drawn_sequence, std::memory_order_release);
+        }
+
+        /**
+         * Writes one line per stage with its latency percentiles over every
+         * input that reached the screen.
+         *
+         * @return Whether the whole file could be written.
+         */
+        bool write(const char *filepath) const
+        {
+            FILE *file = std::fopen(filepath, "w");
+            if (file == nullptr) return false;
+
+            std::fprintf(file, "%-8s %10s %10s %10s %10s %10s\n", "stage", "inputs", "p50_ms", "p90_ms", "p99_ms", "max_ms");
+            for (int i = 0; i < STAGE_COUNT; i++)
+            {
+                const LogHistogram &histogram = this->histograms[i];
+                std::fprintf(file, "%-8s %10llu %10.3f %10.3f %10.3f %10.3f\n",
+                             LATENCY_STAGE_NAMES[i], (unsigned long long) histogram.get_count(),
+                             histogram.get_percentile(0.5), histogram.get_percentile(0.9),
+                             histogram.get_percentile(0.99), histogram.get_max());
+            }
+
+            return std::fclose(file) == 0;
+        }
+};
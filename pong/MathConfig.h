@@ -0,0 +1,22 @@
+#pragma once
+
+/**
+ * Build-wide glm settings; include before any glm header.
+ *
+ * Building with PONG_GLM_SIMD turns on glm's SSE2 or NEON code paths and
+ * makes every vector and matrix 16-byte aligned, so vec4 and mat4 maths
+ * work on whole registers. It changes the types' layout, so every
+ * translation unit has to be built with it or without it, never a mix.
+ *
+ * glm cannot make its types constexpr once intrinsics are on, so constants
+ * of glm types are declared MATH_CONSTANT, which is constexpr whenever it
+ * can be and an inline const otherwise.
+ */
+#ifdef PONG_GLM_SIMD
+#define GLM_FORCE_INTRINSICS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#endif
+
+#include "glm/detail/setup.hpp"
+
+#define MATH_CONSTANT inline GLM_CONSTEXPR const
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+#ifdef _WINDOWS
+#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include "MathConfig.h"
+#include "glm/vec4.hpp"
+#include "FrameSink.h"
+#include "RenderList.h"
+
+#ifdef PONG_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef __APPLE__
+// The legacy 2.1 profile only exposes framebuffer objects through the EXT entry points
+#define glGenFramebuffers         glGenFramebuffersEXT
+#define glBindFramebuffer         glBindFramebufferEXT
+#define glFramebufferTexture2D    glFramebufferTexture2DEXT
+#define glCheckFramebufferStatus  glCheckFramebufferStatusEXT
+#define glDeleteFramebuffers      glDeleteFramebuffersEXT
+#endif
+
+#ifdef PONG_USE_EGL
+/**
+ * Makes a desktop OpenGL context current without any window, preferring
+ * Mesa's surfaceless platform and falling back to a 1x1 pbuffer. Everything
+ * is drawn into a FrameReadback's framebuffer, so the surface size does not
+ * matter.
+ *
+ * @return Whether a context is current.
+ */
+inline bool create_egl_context()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display != nullptr)
+    {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) return false;
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+    const EGLint config_attributes[] =
+    {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+    {
+        return false;
+    }
+
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT) return false;
+
+    if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return true;
+
+    const EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, pbuffer_attributes);
+
+    return surface != EGL_NO_SURFACE && eglMakeCurrent(display, surface, surface, context);
+}
+#endif
+
+/**
+ * Creates a framebuffer object drawing into a new RGBA8 texture of the given
+ * size, leaving the default framebuffer bound.
+ *
+ * @return Whether the framebuffer is complete.
+ */
+inline bool create_texture_framebuffer(int width, int height, GLuint &framebuffer_id, GLuint &texture_id)
+{
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &framebuffer_id);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id, 0);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!complete) std::cerr << "Error: offscreen framebuffer is incomplete.\n";
+    return complete;
+}
+
+/**
+ * Offscreen render target whose frames are read back asynchronously.
+ *
+ * Each captured frame is copied by glReadPixels into one of RING_SIZE pixel
+ * pack buffers, which returns immediately. A buffer is only mapped once the
+ * ring wraps around to it, RING_SIZE - 1 frames later, by which point the
+ * GPU has long finished the copy and mapping does not stall the pipeline.
+ */
+class FrameReadback
+{
+    public:
+        static constexpr int RING_SIZE = 3;
+
+    private:
+        int width, height;
+        GLuint framebuffer_id, colour_texture_id;
+        GLuint pack_buffer_ids[RING_SIZE];
+        int pending_frames[RING_SIZE];
+        int next_buffer = 0;
+        FrameSink sink;
+
+        void deliver(int buffer)
+        {
+            if (this->pending_frames[buffer] < 0) return;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pack_buffer_ids[buffer]);
+            const uint8_t *pixels = (const uint8_t*) glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+
+            if (pixels != nullptr)
+            {
+                this->sink(pixels, this->width, this->height, true, this->pending_frames[buffer]);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            this->pending_frames[buffer] = -1;
+        }
+
+    public:
+        FrameReadback(int width, int height, FrameSink sink)
+        {
+            this->width = width;
+            this->height = height;
+            this->sink = sink;
+
+            create_texture_framebuffer(width, height, this->framebuffer_id, this->colour_texture_id);
+
+            glGenBuffers(RING_SIZE, this->pack_buffer_ids);
+            for (int i = 0; i < RING_SIZE; i++)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pack_buffer_ids[i]);
+                glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 4, nullptr, GL_STREAM_READ);
+                this->pending_frames[i] = -1;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        ~FrameReadback()
+        {
+            glDeleteBuffers(RING_SIZE, this->pack_buffer_ids);
+            glDeleteFramebuffers(1, &this->framebuffer_id);
+            glDeleteTextures(1, &this->colour_texture_id);
+        }
+
+        // Redirects drawing into the offscreen framebuffer
+        void bind()
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer_id);
+        }
+
+        /**
+         * Queues a copy of the frame drawn since bind() and hands the oldest
+         * queued frame to the sink once the ring is full.
+         */
+        void capture(int frame_index)
+        {
+            int buffer = this->next_buffer;
+            this->next_buffer = (this->next_buffer + 1) % RING_SIZE;
+
+            // Reusing a buffer means its previous frame has to go out first
+            this->deliver(buffer);
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->pack_buffer_ids[buffer]);
+            glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            this->pending_frames[buffer] = frame_index;
+        }
+
+        // Delivers every frame still in flight, oldest first
+        void flush()
+        {
+            for (int i = 0; i < RING_SIZE; i++) this->deliver((this->next_buffer + i) % RING_SIZE);
+        }
+};
+
+/**
+ * Static layer of the OpenGL path: the list's static sprites composited once
+ * into a texture, which every frame then copies to the screen as a single
+ * opaque quad instead of redrawing and blending each of them.
+ */
+class StaticLayer
+{
+    private:
+        GLuint framebuffer_id, texture_id;
+        StaticLayerCache cache;
+
+    public:
+        // The layer's rows are bottom-up, so it is sampled upside down
+        static MATH_CONSTANT glm::vec4 TEXTURE_RECT = glm::vec4(0.0f, 1.0f, 1.0f, 0.0f);
+
+        StaticLayer(int width, int height)
+        {
+            create_texture_framebuffer(width, height, this->framebuffer_id, this->texture_id);
+        }
+
+        ~StaticLayer()
+        {
+            glDeleteFramebuffers(1, &this->framebuffer_id);
+            glDeleteTextures(1, &this->texture_id);
+        }
+
+        GLuint get_texture_id() const
+        {
+            return this->texture_id;
+        }
+
+        bool is_valid_for(const RenderList &list) const
+        {
+            return this->cache.is_valid_for(list);
+        }
+
+        // Redirects drawing into the layer; the caller draws the static sprites
+        void begin_update(const RenderList &list)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer_id);
+            this->cache.update(list);
+        }
+
+        void invalidate()
+        {
+            this->cache.invalidate();
+        }
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "pong_lib.h"
+#include "pong_policy.h"
+
+static_assert(PONG_POLICY_MAX_BALLS == Ball::MAX_AMOUNT, "observations have room for every ball");
+
+/**
+ * What a paddle sees of its match. With more balls in play than an
+ * observation has room for, as in chaos mode, it keeps the ones coming at
+ * the paddle that will reach it soonest, then the nearest of the rest, and
+ * lists them in that order.
+ */
+inline PaddleObservation observe(Paddle *paddle, Paddle *opponent, Ball *balls, int ball_count, uint32_t tick)
+{
+    PaddleObservation observation;
+    glm::vec3 position = paddle->get_position();
+
+    observation.paddle_x       = position.x;
+    observation.paddle_y       = position.y;
+    observation.opponent_y     = opponent->get_position().y;
+    observation.side           = position.x < 0.0f ? -1 : 1;
+    observation.score          = paddle->get_score();
+    observation.opponent_score = opponent->get_score();
+    observation.tick           = tick;
+    observation.ball_count     = 0;
+
+    // Incoming balls by how far they have to go to reach the paddle, ahead of the rest by distance
+    struct Rank
+    {
+        bool receding;
+        float key;
+    };
+    auto outranks = [](const Rank &a, const Rank &b) { return a.receding != b.receding ? !a.receding : a.key < b.key; };
+    Rank ranks[PONG_POLICY_MAX_BALLS];
+
+    for (int i = 0; i < ball_count; i++)
+    {
+        if (!balls[i].get_status()) continue;
+
+        glm::vec3 ball_position = balls[i].get_position(),
+                  direction     = balls[i].get_direction();
+        float distance = std::fabs(position.x - ball_position.x);
+
+        Rank rank;
+        rank.receding = direction.x * observation.side <= 0.0f;
+        rank.key      = rank.receding ? distance : std::max(0.0f, distance - STANDARD_WIDTH) / std::fabs(direction.x);
+
+        int slot = observation.ball_count;
+        if (slot == PONG_POLICY_MAX_BALLS)
+        {
+            if (!outranks(rank, ranks[slot - 1])) continue;
+            slot--;
+        }
+        else observation.ball_count++;
+
+        // Insertion sort into the few kept so far; ties keep the earlier ball first
+        for (; slot > 0 && outranks(rank, ranks[slot - 1]); slot--)
+        {
+            ranks[slot] = ranks[slot - 1];
+            observation.balls[slot] = observation.balls[slot - 1];
+        }
+        ranks[slot] = rank;
+        observation.balls[slot] = { ball_position.x, ball_position.y, direction.x, direction.y };
+    }
+    return observation;
+}
+
+// How close to its target a policy's paddle has to be to stop
+constexpr float POLICY_DEAD_ZONE = 0.1f;
+// How long the sweeping bot takes each way, in ticks
+constexpr uint32_t SWEEP_TICKS = 40;
+
+// Up, down or neither, whichever gets the paddle to a height
+inline int move_towards(const PaddleObservation &observation, float target_y)
+{
+    if (target_y > observation.paddle_y + POLICY_DEAD_ZONE) return 1;
+    if (target_y < observation.paddle_y - POLICY_DEAD_ZONE) return -1;
+    return 0;
+}
+
+/**
+ * The ball coming at the paddle that will get there first, or nullptr.
+ *
+ * @param travel Set to how far along its direction the ball has to go
+ *               to reach the paddle.
+ */
+inline const ObservedBall* find_incoming_ball(const PaddleObservation &observation, float &travel)
+{
+    const ObservedBall *incoming = nullptr;
+    for (int i = 0; i < observation.ball_count; i++)
+    {
+        const ObservedBall &ball = observation.balls[i];
+        if (ball.direction_x * observation.side <= 0.0f) continue;
+
+        float distance = std::fabs(observation.paddle_x - ball.x) - STANDARD_WIDTH,
+              to_reach = std::max(0.0f, distance) / std::fabs(ball.direction_x);
+        if (incoming == nullptr || to_reach < travel)
+        {
+            incoming = &ball;
+            travel   = to_reach;
+        }
+    }
+    return incoming;
+}
+
+// Follows the height of the ball coming at it, or heads back to the middle
+inline int track_ball(const PaddleObservation &observation)
+{
+    float travel;
+    const ObservedBall *ball = find_incoming_ball(observation, travel);
+    return move_towards(observation, ball != nullptr ? ball->y : 0.0f);
+}
+
+// Works out where the incoming ball will reach it, walls included, and waits there
+inline int predict_ball(const PaddleObservation &observation)
+{
+    float travel;
+    const ObservedBall *ball = find_incoming_ball(observation, travel);
+    if (ball == nullptr) return move_towards(observation, 0.0f);
+
+    // Unfold the bounces: the ball's height repeats every two crossings of the court
+    float bound  = Ball::VERTICAL_BOUND,
+          period = 4.0f * bound,
+          folded = std::fmod(ball->y + ball->direction_y * travel + bound, period);
+    if (folded < 0.0f)         folded += period;
+    if (folded > 2.0f * bound) folded = period - folded;
+
+    return move_towards(observation, folded - bound);
+}
+
+// Sweeps from top to bottom and back whatever the ball does
+inline int sweep(const PaddleObservation &observation)
+{
+    return (observation.tick / SWEEP_TICKS) % 2 == 0 ? 1 : -1;
+}
+
+/**
+ * A way of moving a paddle: once per tick decide() says which way, 1 up,
+ * -1 down or 0 neither, or a plugin's decide_batch() says so for a whole
+ * batch of paddles at once. With neither the paddle plays as the game's
+ * CPU, bouncing between the walls on its own; see Paddle::update.
+ */
+struct PaddlePolicy
+{
+    const char *name;
+    int (*decide)(const PaddleObservation &observation);
+    PongPolicyDecide decide_batch = nullptr;
+
+    bool is_cpu() const
+    {
+        return this->decide == nullptr && this->decide_batch == nullptr;
+    }
+};
+
+constexpr PaddlePolicy BUILT_IN_POLICIES[] =
+{
+    { "cpu",        nullptr,      nullptr },
+    { "tracker",    track_ball,   nullptr },
+    { "predictive", predict_ball, nullptr },
+    { "sweeper",    sweep,        nullptr },
+};
+
+// The built-in policy of that name, or nullptr
+inline const PaddlePolicy* find_policy(const char *name)
+{
+    for (const PaddlePolicy &policy : BUILT_IN_POLICIES)
+    {
+        if (std::strcmp(policy.name, name) == 0) return &policy;
+    }
+    return nullptr;
+}
+
+// Hands a paddle to a policy, or to the game's CPU when it has none
+inline void assign_policy(Paddle *paddle, const PaddlePolicy &policy)
+{
+    if (paddle->get_status() == policy.is_cpu()) paddle->toggle_playability();
+}
+
+// Decides for a batch of paddles, in one call when the policy takes batches
+inline void decide_batch(const PaddlePolicy &policy, const PaddleObservation *observations, int count,
+                         int32_t *directions)
+{
+    if (count == 0 || policy.is_cpu()) return;
+
+    if (policy.decide_batch != nullptr)
+    {
+        policy.decide_batch(observations, count, directions);
+        return;
+    }
+    for (int i = 0; i < count; i++) directions[i] = policy.decide(observations[i]);
+}
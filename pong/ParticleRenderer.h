@@ -0,0 +1,79 @@
+#pragma once
+
+#include "MathConfig.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "ShaderProgram.h"
+
+#ifdef __APPLE__
+// The legacy 2.1 profile only exposes instancing through the ARB entry points
+#define glDrawArraysInstanced glDrawArraysInstancedARB
+#define glVertexAttribDivisor glVertexAttribDivisorARB
+#endif
+
+/**
+ * Draws a ParticleSystem's instance array, or any other instance batch, as
+ * solid-colour rectangles with a single instanced draw call. The
+ * (x, y, size, alpha) instances are streamed into one buffer each frame;
+ * the shape scales every one of them, so squares unless told otherwise.
+ */
+class ParticleRenderer
+{
+    private:
+        ShaderProgram shader_program;
+        GLuint instance_buffer_id;
+        GLint instance_attribute,
+              shape_uniform;
+        GLsizeiptr instance_buffer_size = 0;
+
+    public:
+        // Takes over a program already loaded from the particle shaders
+        void load(const ShaderProgram &shader_program,
+                  const glm::mat4 &view_matrix, const glm::mat4 &projection_matrix)
+        {
+            this->shader_program = shader_program;
+            this->shader_program.set_projection_matrix(projection_matrix);
+            this->shader_program.set_view_matrix(view_matrix);
+
+            this->instance_attribute = glGetAttribLocation(this->shader_program.get_program_id(), "instance");
+            this->shape_uniform = glGetUniformLocation(this->shader_program.get_program_id(), "shape");
+            glGenBuffers(1, &this->instance_buffer_id);
+        }
+
+        void draw(const glm::vec4 *instances, int count, const glm::vec4 &colour,
+                  const glm::vec2 &shape = glm::vec2(1.0f, 1.0f))
+        {
+            if (count == 0) return;
+
+            float vertices[] =
+            {
+                -0.5f, -0.5f,  0.5f, -0.5f,  0.5f, 0.5f,
+                -0.5f, -0.5f,  0.5f,  0.5f, -0.5f, 0.5f
+            };
+
+            this->shader_program.set_colour(colour.r, colour.g, colour.b, colour.a);
+            glUniform2f(this->shape_uniform, shape.x, shape.y);
+
+            // Orphan the old storage so the upload never waits on the previous frame's draw
+            GLsizeiptr bytes = (GLsizeiptr) count * sizeof(glm::vec4);
+            glBindBuffer(GL_ARRAY_BUFFER, this->instance_buffer_id);
+            if (bytes > this->instance_buffer_size) this->instance_buffer_size = bytes;
+            glBufferData(GL_ARRAY_BUFFER, this->instance_buffer_size, nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances);
+
+            glVertexAttribPointer(this->instance_attribute, 4, GL_FLOAT, false, 0, nullptr);
+            glVertexAttribDivisor(this->instance_attribute, 1);
+            glEnableVertexAttribArray(this->instance_attribute);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            glVertexAttribPointer(this->shader_program.get_position_attribute(), 2, GL_FLOAT, false,
+                                  0, vertices);
+            glEnableVertexAttribArray(this->shader_program.get_position_attribute());
+
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+
+            glDisableVertexAttribArray(this->shader_program.get_position_attribute());
+            glVertexAttribDivisor(this->instance_attribute, 0);
+            glDisableVertexAttribArray(this->instance_attribute);
+        }
+};
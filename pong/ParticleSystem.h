@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MathConfig.h"
+#include "glm/vec4.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define PONG_PARTICLES_SSE 1
+#endif
+
+/**
+ * Pool of short-lived particles for impacts and ball trails.
+ *
+ * Particles are stored as structure-of-arrays so the per-tick kernel can
+ * integrate and age four of them per instruction. Dead slots are recycled
+ * through a free list instead of compacting the arrays, and the kernel
+ * writes one (x, y, size, alpha) instance per slot as it goes; dead slots
+ * get a size of zero, so the instance array can be drawn as is.
+ *
+ * Nothing allocates after construction.
+ */
+class ParticleSystem
+{
+    public:
+        static constexpr int DEFAULT_CAPACITY = 131072;
+        static constexpr float GRAVITY = -4.0f;
+
+    private:
+        int capacity;
+        int high_water = 0; // slots [0, high_water) have been used at least once
+
+        std::vector<float> x, y, vx, vy, age, lifetime, inverse_lifetime, size;
+        std::vector<int> free_list;
+        std::vector<glm::vec4> instances;
+
+        uint32_t random_state = 0x9E3779B9u;
+
+        // xorshift32, so particles never disturb the game's rand() sequence
+        float random_unit()
+        {
+            this->random_state ^= this->random_state << 13;
+            this->random_state ^= this->random_state >> 17;
+            this->random_state ^= this->random_state << 5;
+            return (this->random_state >> 8) * (1.0f / 16777216.0f);
+        }
+
+        void free_slot(int i)
+        {
+            this->free_list.push_back(i);
+        }
+
+    public:
+        ParticleSystem(int capacity = DEFAULT_CAPACITY)
+        {
+            // Round up so the kernel never needs a scalar tail
+            this->capacity = (capacity + 3) & ~3;
+
+            for (std::vector<float> *array : { &this->x, &this->y, &this->vx, &this->vy, &this->age,
+                                               &this->lifetime, &this->inverse_lifetime, &this->size })
+            {
+                array->assign(this->capacity, 0.0f);
+            }
+
+            this->free_list.reserve(this->capacity);
+            this->instances.assign(this->capacity, glm::vec4(0.0f));
+        }
+
+        int get_capacity() const
+        {
+            return this->capacity;
+        }
+
+        int get_live_count() const
+        {
+            return this->high_water - (int) this->free_list.size();
+        }
+
+        // Instances to draw, including zero-sized ones for dead slots
+        const glm::vec4* get_instances() const
+        {
+            return this->instances.data();
+        }
+
+        int get_instance_count() const
+        {
+            return this->high_water;
+        }
+
+        bool is_full() const
+        {
+            return this->free_list.empty() && this->high_water == this->capacity;
+        }
+
+        /**
+         * Starts one particle, silently dropping it when the pool is full.
+         */
+        void spawn(float x, float y, float vx, float vy, float lifetime, float size)
+        {
+            int i;
+            if (!this->free_list.empty())
+            {
+                i = this->free_list.back();
+                this->free_list.pop_back();
+            }
+            else if (this->high_water < this->capacity) i = this->high_water++;
+            else return;
+
+            this->x[i] = x;
+            this->y[i] = y;
+            this->vx[i] = vx;
+            this->vy[i] = vy;
+            this->age[i] = 0.0f;
+            this->lifetime[i] = lifetime;
+            this->inverse_lifetime[i] = 1.0f / lifetime;
+            this->size[i] = size;
+        }
+
+        // Spreads count particles in random directions with up to the given speed
+        void burst(float x, float y, int count, float speed, float lifetime, float size)
+        {
+            if (this->is_full()) return;
+
+            for (int i = 0; i < count; i++)
+            {
+                float theta = 2.0f * (float) M_PI * this->random_unit(),
+                      magnitude = speed * (0.25f + 0.75f * this->random_unit());
+
+                this->spawn(x, y, cosf(theta) * magnitude, sinf(theta) * magnitude,
+                            lifetime * (0.5f + 0.5f * this->random_unit()), size);
+            }
+        }
+
+        // A few slow particles left behind a moving object
+        void trail(float x, float y, int count, float speed, float lifetime, float size)
+        {
+            if (this->is_full()) return;
+
+            for (int i = 0; i < count; i++)
+            {
+                this->spawn(x, y, speed * (this->random_unit() - 0.5f), speed * (this->random_unit() - 0.5f),
+                            lifetime, size);
+            }
+        }
+
+        /**
+         * Integrates and ages every particle, recycles the ones that died
+         * this tick and refreshes the instance array.
+         */
+        void update(float delta_time)
+        {
+            int count = (this->high_water + 3) & ~3;
+            int i = 0;
+
+#ifdef PONG_PARTICLES_SSE
+            const __m128 dt   = _mm_set1_ps(delta_time),
+                         g_dt = _mm_set1_ps(GRAVITY * delta_time),
+                         one  = _mm_set1_ps(1.0f),
+                         zero = _mm_setzero_ps();
+
+            for (; i < count; i += 4)
+            {
+                __m128 age_now  = _mm_loadu_ps(&this->age[i]),
+                       lifetime = _mm_loadu_ps(&this->lifetime[i]);
+                __m128 was_alive = _mm_cmplt_ps(age_now, lifetime);
+
+                age_now = _mm_add_ps(age_now, dt);
+                __m128 alive = _mm_cmplt_ps(age_now, lifetime);
+                _mm_storeu_ps(&this->age[i], age_now);
+
+                __m128 vy_now = _mm_loadu_ps(&this->vy[i]);
+                __m128 x_now  = _mm_add_ps(_mm_loadu_ps(&this->x[i]), _mm_mul_ps(_mm_loadu_ps(&this->vx[i]), dt)),
+                       y_now  = _mm_add_ps(_mm_loadu_ps(&this->y[i]), _mm_mul_ps(vy_now, dt));
+                _mm_storeu_ps(&this->x[i], x_now);
+                _mm_storeu_ps(&this->y[i], y_now);
+                _mm_storeu_ps(&this->vy[i], _mm_add_ps(vy_now, g_dt));
+
+                __m128 alpha = _mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(age_now, _mm_loadu_ps(&this->inverse_lifetime[i]))));
+                __m128 size_now = _mm_and_ps(_mm_loadu_ps(&this->size[i]), alive);
+
+                int died = _mm_movemask_ps(_mm_andnot_ps(alive, was_alive));
+                if (died != 0)
+                {
+                    for (int lane = 0; lane < 4; lane++)
+                    {
+                        if (died & (1 << lane)) this->free_slot(i + lane);
+                    }
+                }
+
+                // Four SoA registers become four (x, y, size, alpha) instances
+                _MM_TRANSPOSE4_PS(x_now, y_now, size_now, alpha);
+                _mm_storeu_ps(&this->instances[i].x,     x_now);
+                _mm_storeu_ps(&this->instances[i + 1].x, y_now);
+                _mm_storeu_ps(&this->instances[i + 2].x, size_now);
+                _mm_storeu_ps(&this->instances[i + 3].x, alpha);
+            }
+#endif
+            for (; i < count; i++)
+            {
+                bool was_alive = this->age[i] < this->lifetime[i];
+                this->age[i] += delta_time;
+                bool alive = this->age[i] < this->lifetime[i];
+
+                this->x[i] += this->vx[i] * delta_time;
+                this->y[i] += this->vy[i] * delta_time;
+                this->vy[i] += GRAVITY * delta_time;
+
+                if (was_alive && !alive) this->free_slot(i);
+
+                float alpha = 1.0f - this->age[i] * this->inverse_lifetime[i];
+                this->instances[i] = glm::vec4(this->x[i], this->y[i], alive ? this->size[i] : 0.0f,
+                                               alpha > 0.0f ? alpha : 0.0f);
+            }
+        }
+
+        void reset()
+        {
+            for (int i = 0; i < this->high_water; i++) this->age[i] = this->lifetime[i] = 0.0f;
+
+            this->high_water = 0;
+            this->free_list.clear();
+        }
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+
+#ifdef _WINDOWS
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "PaddlePolicy.h"
+#include "pong_policy.h"
+
+/**
+ * A paddle policy loaded from a shared library that implements the ABI in
+ * pong_policy.h. The library stays loaded, and the policy usable, for as
+ * long as the plugin lives.
+ */
+class PolicyPlugin
+{
+    private:
+#ifdef _WINDOWS
+        HMODULE library = nullptr;
+#else
+        void *library = nullptr;
+#endif
+        PaddlePolicy policy = { nullptr, nullptr, nullptr };
+        std::string error;
+
+        void* find_symbol(const char *name)
+        {
+#ifdef _WINDOWS
+            return (void*) GetProcAddress(this->library, name);
+#else
+            return dlsym(this->library, name);
+#endif
+        }
+
+        void unload()
+        {
+            if (this->library == nullptr) return;
+#ifdef _WINDOWS
+            FreeLibrary(this->library);
+#else
+            dlclose(this->library);
+#endif
+            this->library = nullptr;
+            this->policy = { nullptr, nullptr, nullptr };
+        }
+
+    public:
+        PolicyPlugin() = default;
+        PolicyPlugin(const PolicyPlugin&) = delete;
+        PolicyPlugin& operator=(const PolicyPlugin&) = delete;
+
+        ~PolicyPlugin()
+        {
+            this->unload();
+        }
+
+        /**
+         * Loads a plugin, replacing any loaded before.
+         *
+         * @return false, with get_error() saying why, if the library cannot
+         *         be opened, lacks one of the ABI's functions or was built
+         *         against another version of it.
+         */
+        bool load(const char *filepath)
+        {
+            this->unload();
+
+#ifdef _WINDOWS
+            this->library = LoadLibraryA(filepath);
+            if (this->library == nullptr)
+            {
+                this->error = std::string("unable to open ") + filepath;
+                return false;
+            }
+#else
+            this->library = dlopen(filepath, RTLD_NOW | RTLD_LOCAL);
+            if (this->library == nullptr)
+            {
+                this->error = dlerror();
+                return false;
+            }
+#endif
+
+            PongPolicyAbiVersion abi_version = (PongPolicyAbiVersion) this->find_symbol("pong_policy_abi_version");
+            PongPolicyName       name        = (PongPolicyName) this->find_symbol("pong_policy_name");
+            PongPolicyDecide     decide      = (PongPolicyDecide) this->find_symbol("pong_policy_decide");
+
+            if (abi_version == nullptr || name == nullptr || decide == nullptr)
+            {
+                this->error = std::string(filepath) + " does not export the pong_policy functions";
+                this->unload();
+                return false;
+            }
+            if (abi_version() != PONG_POLICY_ABI_VERSION)
+            {
+                this->error = std::string(filepath) + " was built for policy ABI version " +
+                              std::to_string(abi_version()) + ", not " + std::to_string(PONG_POLICY_ABI_VERSION);
+                this->unload();
+                return false;
+            }
+
+            this->policy = { name(), nullptr, decide };
+            return true;
+        }
+
+        bool is_loaded() const
+        {
+            return this->library != nullptr;
+        }
+
+        const PaddlePolicy& get_policy() const
+        {
+            return this->policy;
+        }
+
+        const std::string& get_error() const
+        {
+            return this->error;
+        }
+};
+
+// Whether a policy argument names a shared library rather than a built-in policy
+inline bool is_plugin_path(const char *argument)
+{
+    return std::strchr(argument, '/') != nullptr || std::strchr(argument, '\\') != nullptr ||
+           std::strstr(argument, ".so") != nullptr || std::strstr(argument, ".dylib") != nullptr ||
+           std::strstr(argument, ".dll") != nullptr;
+}
+
+/**
+ * The built-in policy of that name, or the plugin at that path, loaded
+ * into plugin.
+ *
+ * @return nullptr if there is no such policy or the plugin fails to load,
+ *         in which case plugin.get_error() says why.
+ */
+inline const PaddlePolicy* find_or_load_policy(const char *argument, PolicyPlugin &plugin)
+{
+    if (!is_plugin_path(argument)) return find_policy(argument);
+
+    if (!plugin.load(argument)) return nullptr;
+    return &plugin.get_policy();
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MathConfig.h"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+
+// Texture rectangle (u0, v0, u1, v1) covering the whole texture; v0 is the top row
+MATH_CONSTANT glm::vec4 FULL_TEXTURE_RECT = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+// Instance batch shape whose instances are squares, size wide and tall
+MATH_CONSTANT glm::vec2 SQUARE_SHAPE = glm::vec2(1.0f, 1.0f);
+
+// Unit quad moved by transform.xy and scaled by transform.zw
+struct Sprite
+{
+    glm::vec4 transform;
+    GLuint texture_id;
+    glm::vec4 texture_rect;
+
+    bool operator==(const Sprite &other) const
+    {
+        return this->texture_id == other.texture_id &&
+               this->transform == other.transform &&
+               this->texture_rect == other.texture_rect;
+    }
+};
+
+/**
+ * Flat list of textured quads making up one frame, in draw order. It is
+ * what both the OpenGL and the software backend consume, so the game only
+ * has to describe a frame once. The storage is fixed so building a frame
+ * never allocates.
+ *
+ * The first get_static_count() sprites form the static layer: sprites that
+ * rarely change and that backends may keep pre-composited between frames.
+ * Particles are drawn last, on top of every sprite.
+ */
+class RenderList
+{
+    public:
+        static constexpr int MAX_SPRITES = 64,
+                             MAX_INSTANCE_BATCHES = 6; // as many as the spectator grid's kinds of shape and colour
+
+        // Rectangles of one colour and shape drawn in a single instanced
+        // call, (x, y, size, alpha) each; they are shape times size across
+        struct InstanceBatch
+        {
+            std::vector<glm::vec4> instances;
+            glm::vec4 colour;
+            glm::vec2 shape;
+        };
+
+    private:
+        Sprite sprites[MAX_SPRITES];
+        int count = 0;
+        int static_count = 0;
+
+        // Drawn over the sprites in order; reserve_instances() keeps them from growing
+        InstanceBatch batches[MAX_INSTANCE_BATCHES];
+        int batch_count = 0;
+
+        uint32_t input_sequence = 0; // newest input applied before it was built, see LatencyTracker
+
+    public:
+        void clear()
+        {
+            this->count = 0;
+            this->static_count = 0;
+            this->batch_count = 0;
+        }
+
+        // Makes room for the most instances any batch will ever hold, so filling them never allocates
+        void reserve_instances(int instance_count)
+        {
+            for (InstanceBatch &batch : this->batches) batch.instances.reserve(instance_count);
+        }
+
+        /**
+         * Starts a batch for the caller to fill in.
+         *
+         * @return Its empty instances, or nullptr once MAX_INSTANCE_BATCHES
+         *         have been added.
+         */
+        std::vector<glm::vec4>* add_batch(const glm::vec4 &colour, const glm::vec2 &shape = SQUARE_SHAPE)
+        {
+            if (this->batch_count >= MAX_INSTANCE_BATCHES) return nullptr;
+
+            InstanceBatch &batch = this->batches[this->batch_count++];
+            batch.instances.clear();
+            batch.colour = colour;
+            batch.shape = shape;
+            return &batch.instances;
+        }
+
+        void add_batch(const glm::vec4 *instances, int instance_count, const glm::vec4 &colour)
+        {
+            std::vector<glm::vec4> *batch = this->add_batch(colour);
+            if (batch != nullptr) batch->assign(instances, instances + instance_count);
+        }
+
+        int get_batch_count() const
+        {
+            return this->batch_count;
+        }
+
+        const InstanceBatch& get_batch(int i) const
+        {
+            return this->batches[i];
+        }
+
+        void set_input_sequence(uint32_t sequence)
+        {
+            this->input_sequence = sequence;
+        }
+
+        uint32_t get_input_sequence() const
+        {
+            return this->input_sequence;
+        }
+
+        // Everything pushed so far belongs to the static layer
+        void mark_static()
+        {
+            this->static_count = this->count;
+        }
+
+        int get_static_count() const
+        {
+            return this->static_count;
+        }
+
+        void push(const glm::vec4 &transform, GLuint texture_id,
+                  const glm::vec4 &texture_rect = FULL_TEXTURE_RECT)
+        {
+            if (this->count >= MAX_SPRITES) return;
+
+            this->sprites[this->count++] = { transform, texture_id, texture_rect };
+        }
+
+        int size() const
+        {
+            return this->count;
+        }
+
+        const Sprite& operator[](int i) const
+        {
+            return this->sprites[i];
+        }
+};
+
+/**
+ * Remembers which sprites a backend's cached static layer was drawn from,
+ * so the cache is only redrawn when the static sprites actually change or
+ * when it is explicitly invalidated.
+ */
+class StaticLayerCache
+{
+    private:
+        Sprite sprites[RenderList::MAX_SPRITES];
+        int count = -1;
+
+    public:
+        bool is_valid_for(const RenderList &list) const
+        {
+            if (this->count != list.get_static_count()) return false;
+
+            for (int i = 0; i < this->count; i++)
+            {
+                if (!(this->sprites[i] == list[i])) return false;
+            }
+            return true;
+        }
+
+        void update(const RenderList &list)
+        {
+            this->count = list.get_static_count();
+            for (int i = 0; i < this->count; i++) this->sprites[i] = list[i];
+        }
+
+        void invalidate()
+        {
+            this->count = -1;
+        }
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "Simulation.h"
+
+/**
+ * Everything the game reads from outside during one tick, so a session can
+ * be recorded and played back exactly: the time step, which way each paddle
+ * is held as the tick starts, how many times a paddle changes direction
+ * during it and which keys were pressed. Bit i of keys stands for the i-th
+ * of the game's replayable keys.
+ */
+struct ReplayFrame
+{
+    float delta_time = 0.0f;
+    int player_one_direction = 0, // 1 up, -1 down, 0 neither
+        player_two_direction = 0;
+    uint32_t keys = 0;
+    int input_count = 0;          // PaddleInputs that go with the tick
+
+    // Whether a run of ticks can be saved as one line
+    bool repeats(const ReplayFrame &other) const
+    {
+        return this->delta_time == other.delta_time &&
+               this->player_one_direction == other.player_one_direction &&
+               this->player_two_direction == other.player_two_direction &&
+               this->keys == other.keys &&
+               this->input_count == 0 && other.input_count == 0;
+    }
+};
+
+constexpr int REPLAY_VERSION = 2;
+// A day of ticks at 60 Hz; longer replays are taken to be corrupt rather than allocated
+constexpr int REPLAY_MAX_TICKS = 60 * 60 * 60 * 24;
+
+/**
+ * A recorded session: the seed rand() was given, one frame per tick and
+ * the paddle inputs that happened partway through ticks. Together they
+ * reproduce the match, as long as the simulation itself has not changed.
+ *
+ * Replays are saved as text, with runs of identical ticks on one line so an
+ * idle stretch costs nothing. A tick with inputs is followed on its line by
+ * one offset, player and direction per input:
+ *
+ *     PONGREPLAY 2
+ *     seed 1234
+ *     <ticks> <delta_time> <player_one_direction> <player_two_direction> <keys> <inputs> [<offset> <player> <direction>]...
+ *     ...
+ *
+ * Version 1 replays, which predate paddle inputs and so have no <inputs>
+ * column, still load.
+ */
+class Replay
+{
+    private:
+        unsigned int seed = 0;
+        std::vector<ReplayFrame> frames;
+        std::vector<int> first_inputs; // per frame, into inputs
+        std::vector<PaddleInput> inputs;
+
+    public:
+        void set_seed(unsigned int seed)       { this->seed = seed; }
+        unsigned int get_seed() const          { return this->seed; }
+
+        int size() const                       { return (int) this->frames.size(); }
+        const ReplayFrame& operator[](int i) const { return this->frames[i]; }
+
+        // The frame's input_count inputs
+        const PaddleInput* get_inputs(int i) const
+        {
+            return this->inputs.data() + this->first_inputs[i];
+        }
+
+        void add(const ReplayFrame &frame, const PaddleInput *frame_inputs)
+        {
+            this->frames.push_back(frame);
+            this->first_inputs.push_back((int) this->inputs.size());
+            this->inputs.insert(this->inputs.end(), frame_inputs, frame_inputs + frame.input_count);
+        }
+
+        /**
+         * @return Whether the file exists and is a complete replay of this
+         *         or an earlier version, with every run at least one tick
+         *         long, no more than REPLAY_MAX_TICKS in all and no
+         *         negative input counts.
+         */
+        bool load(const char *filepath)
+        {
+            FILE *file = std::fopen(filepath, "r");
+            if (file == nullptr) return false;
+
+            this->frames.clear();
+            this->first_inputs.clear();
+            this->inputs.clear();
+
+            int version = 0;
+            bool loaded = std::fscanf(file, " PONGREPLAY %d seed %u", &version, &this->seed) == 2 &&
+                          version >= 1 && version <= REPLAY_VERSION;
+
+            int ticks;
+            ReplayFrame frame;
+            while (loaded && std::fscanf(file, "%d %f %d %d %u", &ticks, &frame.delta_time, &frame.player_one_direction,
+                                         &frame.player_two_direction, &frame.keys) == 5)
+            {
+                frame.input_count = 0;
+                if (version >= 2) loaded = std::fscanf(file, "%d", &frame.input_count) == 1 && frame.input_count >= 0;
+
+                loaded = loaded && ticks >= 1 && ticks <= REPLAY_MAX_TICKS - (int) this->frames.size();
+                if (!loaded) break;
+
+                int first_input = (int) this->inputs.size();
+                for (int i = 0; loaded && i < frame.input_count; i++)
+                {
+                    PaddleInput input;
+                    loaded = std::fscanf(file, "%f %d %d", &input.offset, &input.player, &input.direction) == 3;
+                    this->inputs.push_back(input);
+                }
+
+                this->frames.insert(this->frames.end(), ticks, frame);
+                this->first_inputs.insert(this->first_inputs.end(), ticks, first_input);
+            }
+            loaded = loaded && std::feof(file);
+
+            std::fclose(file);
+            return loaded;
+        }
+
+        /**
+         * @return Whether the whole file could be written.
+         */
+        bool save(const char *filepath) const
+        {
+            FILE *file = std::fopen(filepath, "w");
+            if (file == nullptr) return false;
+
+            std::fprintf(file, "PONGREPLAY %d\nseed %u\n", REPLAY_VERSION, this->seed);
+            for (size_t i = 0; i < this->frames.size();)
+            {
+                size_t run = 1;
+                while (i + run < this->frames.size() && this->frames[i + run].repeats(this->frames[i])) run++;
+
+                // Nine significant digits round-trip any float exactly
+                const ReplayFrame &frame = this->frames[i];
+                std::fprintf(file, "%zu %.9g %d %d %u %d", run, frame.delta_time, frame.player_one_direction,
+                             frame.player_two_direction, frame.keys, frame.input_count);
+
+                const PaddleInput *frame_inputs = this->get_inputs((int) i);
+                for (int j = 0; j < frame.input_count; j++)
+                {
+                    std::fprintf(file, " %.9g %d %d", frame_inputs[j].offset, frame_inputs[j].player, frame_inputs[j].direction);
+                }
+                std::fprintf(file, "\n");
+
+                i += run;
+            }
+
+            return std::fclose(file) == 0;
+        }
+};
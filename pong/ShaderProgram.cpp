@@ -23,6 +23,20 @@ void ShaderProgram::load(const char *vertex_shader_file, const char *fragment_sh
     // create the fragment shader
     m_fragment_shader = load_shader_from_file(fragment_shader_file, GL_FRAGMENT_SHADER);
     
+    link_program();
+}
+
+void ShaderProgram::load_from_source(const char *vertex_shader_source, int vertex_shader_length,
+                                     const char *fragment_shader_source, int fragment_shader_length)
+{
+    m_vertex_shader   = load_shader_from_source(vertex_shader_source, vertex_shader_length, GL_VERTEX_SHADER);
+    m_fragment_shader = load_shader_from_source(fragment_shader_source, fragment_shader_length, GL_FRAGMENT_SHADER);
+    
+    link_program();
+}
+
+void ShaderProgram::link_program()
+{
     // Create the final shader program from our vertex and fragment shaders
     m_program_id = glCreateProgram();
     glAttachShader(m_program_id, m_vertex_shader);
@@ -37,10 +51,12 @@ void ShaderProgram::load(const char *vertex_shader_file, const char *fragment_sh
         printf("Error linking shader program!\n");
     }
     
-    m_model_matrix_uniform      = glGetUniformLocation(m_program_id, "modelMatrix");
-    m_projection_matrix_uniform = glGetUniformLocation(m_program_id, "projectionMatrix");
-    m_view_matrix_uniform       = glGetUniformLocation(m_program_id, "viewMatrix");
-    m_colour_uniform            = glGetUniformLocation(m_program_id, "color");
+    m_model_transform_uniform        = glGetUniformLocation(m_program_id, "modelTransform");
+    m_view_projection_matrix_uniform = glGetUniformLocation(m_program_id, "viewProjectionMatrix");
+    m_colour_uniform                 = glGetUniformLocation(m_program_id, "color");
+    
+    m_view_matrix       = glm::mat4(1.0f);
+    m_projection_matrix = glm::mat4(1.0f);
     
     m_position_attribute  = glGetAttribLocation(m_program_id, "position");
     m_tex_coord_attribute = glGetAttribLocation(m_program_id, "texCoord");
@@ -74,14 +90,16 @@ GLuint ShaderProgram::load_shader_from_file(const std::string &shaderFile, GLenu
 }
 
 GLuint ShaderProgram::load_shader_from_string(const std::string &shaderContents, GLenum type)
+{
+    // Get the pointer to the C string from the STL string
+    return load_shader_from_source(shaderContents.c_str(), (GLint) shaderContents.size(), type);
+}
+
+GLuint ShaderProgram::load_shader_from_source(const char *shader_string, GLint shader_string_length, GLenum type)
 {
     // Create a shader of specified type
     GLuint shaderID = glCreateShader(type);
     
-    // Get the pointer to the C string from the STL string
-    const char *shader_string  = shaderContents.c_str();
-    GLint shader_string_length = (GLint) shaderContents.size();
-    
     // Set the shader source to the string and compile shader
     glShaderSource(shaderID, 1, &shader_string, &shader_string_length);
     glCompileShader(shaderID);
@@ -110,18 +128,25 @@ void ShaderProgram::set_colour(float red, float green, float blue, float alpha)
 
 void ShaderProgram::set_view_matrix(const glm::mat4 &matrix)
 {
+    m_view_matrix = matrix;
+    
+    // The shaders only ever need the product, so it is computed once here
+    glm::mat4 view_projection = m_projection_matrix * m_view_matrix;
     glUseProgram(m_program_id);
-    glUniformMatrix4fv(m_view_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
+    glUniformMatrix4fv(m_view_projection_matrix_uniform, 1, GL_FALSE, &view_projection[0][0]);
 }
 
-void ShaderProgram::set_model_matrix(const glm::mat4 &matrix)
+void ShaderProgram::set_model_transform(const glm::vec4 &transform)
 {
     glUseProgram(m_program_id);
-    glUniformMatrix4fv(m_model_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
+    glUniform4f(m_model_transform_uniform, transform.x, transform.y, transform.z, transform.w);
 }
 
 void ShaderProgram::set_projection_matrix(const glm::mat4 &matrix)
 {
+    m_projection_matrix = matrix;
+    
+    glm::mat4 view_projection = m_projection_matrix * m_view_matrix;
     glUseProgram(m_program_id);
-    glUniformMatrix4fv(m_projection_matrix_uniform, 1, GL_FALSE, &matrix[0][0]);
+    glUniformMatrix4fv(m_view_projection_matrix_uniform, 1, GL_FALSE, &view_projection[0][0]);
 }
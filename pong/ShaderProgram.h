@@ -18,23 +18,28 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include "MathConfig.h"
 #include "glm/mat4x4.hpp"
 
 class ShaderProgram
 {
 private:
     void cleanup();
+    void link_program();
     
+    GLuint load_shader_from_source(const char *shader_source, GLint shader_length, GLenum shader_type);
     GLuint load_shader_from_string(const std::string &shader_contents, GLenum shader_type);
     GLuint load_shader_from_file(const std::string &shader_file, GLenum shader_type);
 
     GLuint m_program_id;
 
-    GLuint m_projection_matrix_uniform;
-    GLuint m_model_matrix_uniform;
-    GLuint m_view_matrix_uniform;
+    GLuint m_view_projection_matrix_uniform;
+    GLuint m_model_transform_uniform;
     GLuint m_colour_uniform;
 
+    glm::mat4 m_view_matrix;
+    glm::mat4 m_projection_matrix;
+
     GLuint m_position_attribute;
     GLuint m_tex_coord_attribute;
 
@@ -44,8 +49,11 @@ private:
 public:
 
     void load(const char *vertex_shader_file, const char *fragment_shader_file);
+    // Sources need not be null-terminated
+    void load_from_source(const char *vertex_shader_source, int vertex_shader_length,
+                          const char *fragment_shader_source, int fragment_shader_length);
 
-    void set_model_matrix(const glm::mat4 &matrix);
+    void set_model_transform(const glm::vec4 &transform);
     void set_projection_matrix(const glm::mat4 &matrix);
     void set_view_matrix(const glm::mat4 &matrix);
     void set_colour(float red, float green, float blue, float alpha);
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include "pong_lib.h"
+#include "BallPool.h"
+#include "ParticleSystem.h"
+#include "TraceEvents.h"
+
+// Particles per event, and how far, long and large they go
+constexpr int   PADDLE_BURST_COUNT = 24,
+                WALL_BURST_COUNT   = 12,
+                SCORE_BURST_COUNT  = 96,
+                TRAIL_COUNT        = 2;
+constexpr float BURST_SPEED        = 2.5f,
+                BURST_LIFETIME     = 0.5f,
+                TRAIL_SPEED        = 0.3f,
+                TRAIL_LIFETIME     = 0.35f,
+                PARTICLE_SIZE      = 0.05f;
+
+// A player's paddle changing direction partway through a tick
+struct PaddleInput
+{
+    float offset;  // in seconds since the tick started
+    int player;    // 1 or 2
+    int direction; // 1 up, -1 down, 0 neither
+};
+
+inline void set_paddle_direction(Paddle *paddle, int direction)
+{
+    if      (direction > 0) paddle->set_up();
+    else if (direction < 0) paddle->set_down();
+    else                    paddle->set_neutral();
+}
+
+/**
+ * Moves a paddle through one tick, changing direction at the moment each
+ * of its inputs happened rather than at the start of the next tick. Inputs
+ * must be in order; ones for a CPU-controlled paddle are ignored.
+ */
+inline void update_paddle(float delta_time, Paddle *paddle, int player, const PaddleInput *inputs, int input_count)
+{
+    float elapsed = 0.0f;
+    if (paddle->get_status())
+    {
+        for (int i = 0; i < input_count; i++)
+        {
+            if (inputs[i].player != player) continue;
+
+            float offset = std::min(std::max(inputs[i].offset, elapsed), delta_time);
+            if (offset > elapsed) paddle->update(offset - elapsed);
+            elapsed = offset;
+
+            set_paddle_direction(paddle, inputs[i].direction);
+        }
+    }
+    paddle->update(delta_time - elapsed);
+}
+
+/**
+ * Moves one ball a tick against the paddle on its half and spawns its
+ * particles, with a trail only if asked. A ball that leaves the court
+ * scores for the other side.
+ *
+ * @return Whether the ball scored.
+ */
+inline bool step_ball(float delta_time, Ball &ball, Paddle *player_one, Paddle *player_two,
+                      ParticleSystem *particles, bool trail, bool &hit_paddle)
+{
+    if (ball.get_position().x <= 0)
+    {
+        hit_paddle = ball.update(delta_time, player_one);
+        if (hit_paddle) ball.set_player_one();
+    }
+    else
+    {
+        hit_paddle = ball.update(delta_time, player_two);
+        if (hit_paddle) ball.set_player_two();
+    }
+
+    if (hit_paddle)           TRACE_INSTANT("paddle_hit");
+    if (ball.get_wall_hit()) TRACE_INSTANT("wall_hit");
+
+    glm::vec3 position = ball.get_position();
+    if (particles != nullptr)
+    {
+        if (hit_paddle)
+        {
+            particles->burst(position.x, position.y, PADDLE_BURST_COUNT, BURST_SPEED, BURST_LIFETIME, PARTICLE_SIZE);
+        }
+        if (ball.get_wall_hit())
+        {
+            particles->burst(position.x, position.y, WALL_BURST_COUNT, BURST_SPEED, BURST_LIFETIME, PARTICLE_SIZE);
+        }
+        if (trail) particles->trail(position.x, position.y, TRAIL_COUNT, TRAIL_SPEED, TRAIL_LIFETIME, PARTICLE_SIZE);
+    }
+
+    if (!ball.is_out_of_bounds(player_one, player_two)) return false;
+
+    TRACE_INSTANT("score");
+    TRACE_COUNTER("score_player_one", player_one->get_score());
+    TRACE_COUNTER("score_player_two", player_two->get_score());
+
+    if (particles != nullptr)
+    {
+        particles->burst(position.x, position.y, SCORE_BURST_COUNT, BURST_SPEED, BURST_LIFETIME, PARTICLE_SIZE);
+    }
+    return true;
+}
+
+/**
+ * Advances one match by a tick: moves both paddles, moves every enabled
+ * ball against the paddle on its half, scores and resets the balls when
+ * one leaves the court, and spawns particles for hits, trails and points.
+ * Paddle inputs take effect partway through the tick, where they happened.
+ * Effects are skipped when there is no particle system.
+ */
+inline void update_match(float delta_time, Paddle *player_one, Paddle *player_two, Ball *balls, int ball_count,
+                         ParticleSystem *particles, const PaddleInput *inputs = nullptr, int input_count = 0)
+{
+    update_paddle(delta_time, player_one, 1, inputs, input_count);
+    update_paddle(delta_time, player_two, 2, inputs, input_count);
+
+    for (int i = 0; i < ball_count; i++)
+    {
+        if (!balls[i].get_status()) continue;
+
+        bool hit_paddle;
+        if (step_ball(delta_time, balls[i], player_one, player_two, particles, true, hit_paddle))
+        {
+            for (int j = 0; j < ball_count; j++) balls[j].reset();
+            break;
+        }
+    }
+
+    if (particles != nullptr)
+    {
+        particles->update(delta_time);
+        TRACE_COUNTER("live_particles", particles->get_live_count());
+    }
+
+    /* Transformations */
+    update_transforms(player_one, player_two, balls, ball_count);
+}
+
+// How a chaos match grows and shrinks
+struct ChaosRules
+{
+    bool split_on_paddle_hit = true;  // a ball that hits a paddle spawns its mirror image
+    int  serve_when_empty    = 1;     // balls served from the centre once none are left
+    bool trails              = false; // two trail particles per ball per tick swamp the pool
+};
+
+/**
+ * Advances a chaos match by a tick. Unlike update_match, every ball that
+ * leaves the court scores on its own and is despawned, and the others play
+ * on. Balls are stepped from the back, so despawning one only ever moves a
+ * ball that has been stepped already into its place, and balls spawned by
+ * splits wait for the next tick.
+ */
+inline void update_chaos(float delta_time, Paddle *player_one, Paddle *player_two, BallPool &pool,
+                         ParticleSystem *particles, const ChaosRules &rules,
+                         const PaddleInput *inputs = nullptr, int input_count = 0)
+{
+    update_paddle(delta_time, player_one, 1, inputs, input_count);
+    update_paddle(delta_time, player_two, 2, inputs, input_count);
+
+    for (int i = pool.get_live_count() - 1; i >= 0; i--)
+    {
+        Ball &ball = pool[i];
+
+        bool hit_paddle;
+        if (step_ball(delta_time, ball, player_one, player_two, particles, rules.trails, hit_paddle))
+        {
+            pool.despawn_at(i);
+            continue;
+        }
+
+        if (hit_paddle && rules.split_on_paddle_hit)
+        {
+            glm::vec3 direction = ball.get_direction();
+            BallHandle child = pool.spawn(ball);
+            if (Ball *split = pool.get(child)) split->set_direction(glm::vec3(direction.x, -direction.y, 0.0f));
+        }
+    }
+
+    if (pool.get_live_count() == 0)
+    {
+        for (int i = 0; i < rules.serve_when_empty; i++) pool.spawn(Ball());
+    }
+
+    if (particles != nullptr)
+    {
+        particles->update(delta_time);
+        TRACE_COUNTER("live_particles", particles->get_live_count());
+    }
+    TRACE_COUNTER("live_balls", pool.get_live_count());
+
+    player_one->update_transform();
+    player_two->update_transform();
+    for (int i = 0; i < pool.get_live_count(); i++) pool[i].update_transform();
+}
+
+// Where every hash_match chain starts
+constexpr uint64_t MATCH_HASH_SEED = 14695981039346656037ull;
+
+/**
+ * Folds everything that decides how a match goes, the paddles, the enabled
+ * balls and the scores, into a running FNV-1a hash. Hashing after every
+ * tick of the same replay tells whether two builds play bit for bit alike.
+ */
+inline uint64_t hash_match(uint64_t hash, Paddle *player_one, Paddle *player_two, Ball *balls, int ball_count)
+{
+    auto fold = [&hash](const void *data, size_t size)
+    {
+        const unsigned char *bytes = (const unsigned char*) data;
+        for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    };
+
+    for (Paddle *paddle : { player_one, player_two })
+    {
+        int score = paddle->get_score();
+        fold(&paddle->get_transform().y, sizeof(float));
+        fold(&score, sizeof(score));
+    }
+
+    for (int i = 0; i < ball_count; i++)
+    {
+        if (balls[i].get_status()) fold(&balls[i].get_transform(), 2 * sizeof(float));
+    }
+
+    return hash;
+}
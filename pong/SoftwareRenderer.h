@@ -0,0 +1,333 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "MathConfig.h"
+#include "glm/mat4x4.hpp"
+
+#include "FrameSink.h"
+#include "RenderList.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PONG_SOFTWARE_SSE2 1
+#endif
+
+/**
+ * CPU rasteriser for the game's sprite list. It draws the same quads as the
+ * OpenGL path (unit quad scaled and moved by its transform, nearest texture
+ * sampling, blended like glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA))
+ * into an RGBA framebuffer in memory, so frames can be produced without a
+ * display or a GL driver.
+ *
+ * Only axis-aligned quads are supported, which is all the game ever draws.
+ * Pixels are stored as 0xAABBGGRR, i.e. R, G, B, A bytes in memory.
+ */
+class SoftwareRenderer
+{
+    private:
+        struct Texture
+        {
+            int width = 0,
+                height = 0;
+            std::vector<uint32_t> texels;
+        };
+
+        int width, height;
+        std::vector<uint32_t> framebuffer;
+
+        // Pre-composited static layer, copied in at the start of every frame
+        std::vector<uint32_t> static_layer;
+        StaticLayerCache static_layer_cache;
+        std::vector<Texture> textures;
+        glm::mat4 view_projection_matrix;
+
+        // Scratch buffers for one span, kept around so drawing never allocates
+        std::vector<int> column_lookup;
+        std::vector<uint32_t> span;
+
+        static uint32_t blend_pixel(uint32_t src, uint32_t dst)
+        {
+            uint32_t alpha = src >> 24;
+            if (alpha == 255) return src;
+            if (alpha == 0)   return dst;
+
+            uint32_t inverse = 255 - alpha, result = 0;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                uint32_t x = ((src >> shift) & 0xFF) * alpha + ((dst >> shift) & 0xFF) * inverse + 128;
+                result |= (((x + (x >> 8)) >> 8) & 0xFF) << shift;
+            }
+            return result;
+        }
+
+        static void blend_span(uint32_t *dst, const uint32_t *src, int count)
+        {
+            int i = 0;
+#ifdef PONG_SOFTWARE_SSE2
+            const __m128i zero      = _mm_setzero_si128(),
+                          all_255   = _mm_set1_epi16(255),
+                          round     = _mm_set1_epi16(128),
+                          alpha_255 = _mm_set1_epi32((int) 0xFF000000);
+
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+
+                // Fully opaque and fully transparent groups need no arithmetic
+                __m128i alpha_bits = _mm_and_si128(s, alpha_255);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha_bits, alpha_255)) == 0xFFFF)
+                {
+                    _mm_storeu_si128((__m128i*) (dst + i), s);
+                    continue;
+                }
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha_bits, zero)) == 0xFFFF) continue;
+
+                __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+
+                __m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero),
+                        d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+
+                // Broadcast each pixel's alpha across its four 16-bit lanes
+                __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)),
+                        a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+                // x = src * a + dst * (255 - a) + 128, then (x + (x >> 8)) >> 8 is x / 255 rounded
+                __m128i x_lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s_lo, a_lo),
+                                                           _mm_mullo_epi16(d_lo, _mm_sub_epi16(all_255, a_lo))), round),
+                        x_hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s_hi, a_hi),
+                                                           _mm_mullo_epi16(d_hi, _mm_sub_epi16(all_255, a_hi))), round);
+                x_lo = _mm_srli_epi16(_mm_add_epi16(x_lo, _mm_srli_epi16(x_lo, 8)), 8);
+                x_hi = _mm_srli_epi16(_mm_add_epi16(x_hi, _mm_srli_epi16(x_hi, 8)), 8);
+
+                _mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(x_lo, x_hi));
+            }
+#endif
+            for (; i < count; i++) dst[i] = blend_pixel(src[i], dst[i]);
+        }
+
+    public:
+        SoftwareRenderer(int width, int height)
+        {
+            this->width = width;
+            this->height = height;
+            this->framebuffer.assign((size_t) width * height, 0);
+            this->static_layer.assign((size_t) width * height, 0);
+            this->column_lookup.resize(width);
+            this->span.resize(width);
+            this->view_projection_matrix = glm::mat4(1.0f);
+        }
+
+        int get_width() const
+        {
+            return this->width;
+        }
+
+        int get_height() const
+        {
+            return this->height;
+        }
+
+        // Top-down rows of width * height pixels
+        const uint32_t* get_pixels() const
+        {
+            return this->framebuffer.data();
+        }
+
+        void set_view_projection_matrix(const glm::mat4 &matrix)
+        {
+            this->view_projection_matrix = matrix;
+        }
+
+        /**
+         * Copies an RGBA8 image (as returned by stbi_load) into the renderer.
+         * The returned id plays the role of a GL texture name and is never 0.
+         */
+        GLuint add_texture(int texture_width, int texture_height, const unsigned char *rgba)
+        {
+            GLuint texture_id = this->reserve_texture();
+            this->set_texture(texture_id, texture_width, texture_height, rgba);
+            return texture_id;
+        }
+
+        // An id with no pixels yet, like a GL texture name before glTexImage2D
+        GLuint reserve_texture()
+        {
+            this->textures.emplace_back();
+            return (GLuint) this->textures.size();
+        }
+
+        void set_texture(GLuint texture_id, int texture_width, int texture_height, const unsigned char *rgba)
+        {
+            Texture &texture = this->textures[texture_id - 1];
+            texture.width = texture_width;
+            texture.height = texture_height;
+            texture.texels.resize((size_t) texture_width * texture_height);
+            std::memcpy(texture.texels.data(), rgba, texture.texels.size() * sizeof(uint32_t));
+        }
+
+        // Frees a texture's pixels but keeps its id; sprites using it draw nothing
+        void release_texture(GLuint texture_id)
+        {
+            Texture &texture = this->textures[texture_id - 1];
+            texture.width = texture.height = 0;
+            std::vector<uint32_t>().swap(texture.texels);
+        }
+
+        void clear(float red, float green, float blue, float alpha)
+        {
+            uint32_t colour = (uint32_t) (red   * 255.0f + 0.5f)       |
+                              (uint32_t) (green * 255.0f + 0.5f) << 8  |
+                              (uint32_t) (blue  * 255.0f + 0.5f) << 16 |
+                              (uint32_t) (alpha * 255.0f + 0.5f) << 24;
+            std::fill(this->framebuffer.begin(), this->framebuffer.end(), colour);
+        }
+
+        void draw(const Sprite &sprite)
+        {
+            if (sprite.texture_id == 0 || sprite.texture_id > this->textures.size()) return;
+            const Texture &texture = this->textures[sprite.texture_id - 1];
+            if (texture.width == 0) return;
+
+            // Project the quad's corners and map them from NDC to top-down pixel space
+            const glm::vec4 &transform = sprite.transform;
+            glm::vec4 low  = this->view_projection_matrix * glm::vec4(transform.x - 0.5f * transform.z,
+                                                                     transform.y - 0.5f * transform.w, 0.0f, 1.0f),
+                      high = this->view_projection_matrix * glm::vec4(transform.x + 0.5f * transform.z,
+                                                                     transform.y + 0.5f * transform.w, 0.0f, 1.0f);
+
+            float left   = (low.x  / low.w  + 1.0f) * 0.5f * this->width,
+                  right  = (high.x / high.w + 1.0f) * 0.5f * this->width,
+                  top    = (1.0f - high.y / high.w) * 0.5f * this->height,
+                  bottom = (1.0f - low.y  / low.w)  * 0.5f * this->height;
+
+            float u0 = sprite.texture_rect.x, v0 = sprite.texture_rect.y,
+                  u1 = sprite.texture_rect.z, v1 = sprite.texture_rect.w;
+            if (right < left)  { std::swap(left, right); std::swap(u0, u1); }
+            if (bottom < top)  { std::swap(top, bottom); std::swap(v0, v1); }
+
+            // Cover the pixels whose centres fall inside the quad, like GL does
+            int x_start = std::max(0, (int) std::ceil(left - 0.5f)),
+                x_end   = std::min(this->width, (int) std::ceil(right - 0.5f)),
+                y_start = std::max(0, (int) std::ceil(top - 0.5f)),
+                y_end   = std::min(this->height, (int) std::ceil(bottom - 0.5f));
+            if (x_start >= x_end || y_start >= y_end) return;
+
+            // Columns are the same for every row of an axis-aligned quad
+            float u_step = (u1 - u0) / (right - left);
+            for (int x = x_start; x < x_end; x++)
+            {
+                float u = u0 + (x + 0.5f - left) * u_step;
+                int column = (int) std::floor(u * texture.width);
+                this->column_lookup[x - x_start] = std::max(0, std::min(column, texture.width - 1));
+            }
+
+            float v_step = (v1 - v0) / (bottom - top);
+            int span_width = x_end - x_start;
+            for (int y = y_start; y < y_end; y++)
+            {
+                float v = v0 + (y + 0.5f - top) * v_step;
+                int row = std::max(0, std::min((int) std::floor(v * texture.height), texture.height - 1));
+
+                const uint32_t *texel_row = texture.texels.data() + (size_t) row * texture.width;
+                for (int i = 0; i < span_width; i++) this->span[i] = texel_row[this->column_lookup[i]];
+
+                blend_span(this->framebuffer.data() + (size_t) y * this->width + x_start,
+                           this->span.data(), span_width);
+            }
+        }
+
+        // Solid-colour rectangles, shape times size across, faded by each instance's alpha
+        void draw_particles(const glm::vec4 *instances, int count, const glm::vec4 &colour,
+                            const glm::vec2 &shape = glm::vec2(1.0f, 1.0f))
+        {
+            uint32_t rgb = (uint32_t) (colour.r * 255.0f + 0.5f)       |
+                           (uint32_t) (colour.g * 255.0f + 0.5f) << 8  |
+                           (uint32_t) (colour.b * 255.0f + 0.5f) << 16;
+
+            for (int i = 0; i < count; i++)
+            {
+                const glm::vec4 &instance = instances[i];
+                if (instance.z <= 0.0f) continue;
+
+                float half_width  = 0.5f * shape.x * instance.z,
+                      half_height = 0.5f * shape.y * instance.z;
+                glm::vec4 low  = this->view_projection_matrix * glm::vec4(instance.x - half_width,
+                                                                         instance.y - half_height, 0.0f, 1.0f),
+                          high = this->view_projection_matrix * glm::vec4(instance.x + half_width,
+                                                                         instance.y + half_height, 0.0f, 1.0f);
+
+                int x_start = std::max(0, (int) std::ceil((low.x / low.w + 1.0f) * 0.5f * this->width - 0.5f)),
+                    x_end   = std::min(this->width, (int) std::ceil((high.x / high.w + 1.0f) * 0.5f * this->width - 0.5f)),
+                    y_start = std::max(0, (int) std::ceil((1.0f - high.y / high.w) * 0.5f * this->height - 0.5f)),
+                    y_end   = std::min(this->height, (int) std::ceil((1.0f - low.y / low.w) * 0.5f * this->height - 0.5f));
+                if (x_start >= x_end || y_start >= y_end) continue;
+
+                uint32_t pixel = rgb | (uint32_t) (colour.a * instance.w * 255.0f + 0.5f) << 24;
+                std::fill(this->span.begin(), this->span.begin() + (x_end - x_start), pixel);
+
+                for (int y = y_start; y < y_end; y++)
+                {
+                    blend_span(this->framebuffer.data() + (size_t) y * this->width + x_start,
+                               this->span.data(), x_end - x_start);
+                }
+            }
+        }
+
+        void draw_batches(const RenderList &list)
+        {
+            for (int i = 0; i < list.get_batch_count(); i++)
+            {
+                const RenderList::InstanceBatch &batch = list.get_batch(i);
+                this->draw_particles(batch.instances.data(), (int) batch.instances.size(), batch.colour, batch.shape);
+            }
+        }
+
+        void draw(const RenderList &list)
+        {
+            for (int i = 0; i < list.size(); i++) this->draw(list[i]);
+
+            this->draw_batches(list);
+        }
+
+        /**
+         * Draws a whole frame. The static layer is only rasterised when it
+         * differs from the cached one; otherwise it is copied in, which also
+         * takes the place of clearing.
+         */
+        void render(const RenderList &list, float red, float green, float blue, float alpha)
+        {
+            if (!this->static_layer_cache.is_valid_for(list))
+            {
+                this->clear(red, green, blue, alpha);
+                for (int i = 0; i < list.get_static_count(); i++) this->draw(list[i]);
+
+                this->static_layer = this->framebuffer;
+                this->static_layer_cache.update(list);
+            }
+            else
+            {
+                std::memcpy(this->framebuffer.data(), this->static_layer.data(),
+                            this->framebuffer.size() * sizeof(uint32_t));
+            }
+
+            for (int i = list.get_static_count(); i < list.size(); i++) this->draw(list[i]);
+
+            this->draw_batches(list);
+        }
+
+        void invalidate_static_layer()
+        {
+            this->static_layer_cache.invalidate();
+        }
+
+        // Writes the framebuffer as a binary PPM, dropping the alpha channel
+        bool write_ppm(const char *filepath) const
+        {
+            return ::write_ppm(filepath, (const uint8_t*) this->framebuffer.data(),
+                               this->width, this->height, false);
+        }
+};
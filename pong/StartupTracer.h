@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Records how long each startup phase and each asset took, from any thread,
+ * against one monotonic clock that starts when the tracer is created.
+ *
+ * The result is written twice: as a table for reading at a glance, and as
+ * Chrome trace JSON (chrome://tracing or ui.perfetto.dev) to see which
+ * threads overlapped and where the long pole is. Recording takes a lock,
+ * which is fine for the few dozen spans startup produces. Once stopped,
+ * the tracer ignores anything recorded later, so threads still holding it
+ * need not be told.
+ */
+class StartupTracer
+{
+    private:
+        struct Span
+        {
+            std::string phase, asset;
+            int thread;
+            double start_us, end_us;
+            long long bytes; // negative when not applicable
+        };
+
+        std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        std::mutex mutex;
+        std::vector<Span> spans;
+        std::vector<std::thread::id> threads; // trace thread ids, in order of first appearance
+        std::atomic<bool> stopped{false};
+
+        int get_thread_index(std::thread::id id)
+        {
+            for (size_t i = 0; i < this->threads.size(); i++)
+            {
+                if (this->threads[i] == id) return (int) i;
+            }
+            this->threads.push_back(id);
+            return (int) this->threads.size() - 1;
+        }
+
+        static void write_json_string(FILE *file, const std::string &text)
+        {
+            std::fputc('"', file);
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\') std::fputc('\\', file);
+                std::fputc(c, file);
+            }
+            std::fputc('"', file);
+        }
+
+    public:
+        // Microseconds since the tracer was created
+        double now() const
+        {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - this->origin).count();
+        }
+
+        void stop()
+        {
+            this->stopped = true;
+        }
+
+        bool is_stopped() const
+        {
+            return this->stopped;
+        }
+
+        void record(const char *phase, const char *asset, double start_us, double end_us, long long bytes = -1)
+        {
+            if (this->stopped) return;
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->spans.push_back({ phase, asset != nullptr ? asset : "",
+                                    this->get_thread_index(std::this_thread::get_id()),
+                                    start_us, end_us, bytes });
+        }
+
+        // One line per span, in the order they started
+        void write_summary(FILE *file)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            std::vector<Span> sorted = this->spans;
+            std::stable_sort(sorted.begin(), sorted.end(),
+                             [](const Span &a, const Span &b) { return a.start_us < b.start_us; });
+
+            double end_us = 0.0;
+            std::fprintf(file, "%-16s %-36s %6s %10s %10s %10s\n",
+                         "phase", "asset", "thread", "start_ms", "dur_us", "bytes");
+            for (const Span &span : sorted)
+            {
+                std::fprintf(file, "%-16s %-36s %6d %10.3f %10.0f ",
+                             span.phase.c_str(), span.asset.c_str(), span.thread,
+                             span.start_us / 1000.0, span.end_us - span.start_us);
+                if (span.bytes >= 0) std::fprintf(file, "%10lld\n", span.bytes);
+                else                 std::fprintf(file, "%10s\n", "-");
+
+                end_us = std::max(end_us, span.end_us);
+            }
+            std::fprintf(file, "total %.3f ms\n", end_us / 1000.0);
+        }
+
+        /**
+         * Writes every span as a complete ("X") event of the Chrome trace
+         * event format.
+         *
+         * @return Whether the whole file could be written.
+         */
+        bool write_trace(const char *filepath)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            FILE *file = std::fopen(filepath, "w");
+            if (file == nullptr) return false;
+
+            std::fprintf(file, "{\"traceEvents\":[\n");
+            for (size_t i = 0; i < this->spans.size(); i++)
+            {
+                const Span &span = this->spans[i];
+
+                std::fprintf(file, "{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"cat\":\"startup\",\"name\":",
+                             span.thread, span.start_us, span.end_us - span.start_us);
+                write_json_string(file, span.asset.empty() ? span.phase : span.phase + " " + span.asset);
+                std::fprintf(file, ",\"args\":{");
+                if (span.bytes >= 0) std::fprintf(file, "\"bytes\":%lld", span.bytes);
+                std::fprintf(file, "}}%s\n", i + 1 < this->spans.size() ? "," : "");
+            }
+            std::fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+            return std::fclose(file) == 0;
+        }
+};
+
+/**
+ * Records the time between construction and destruction as one span. A
+ * null tracer turns it into a no-op, so call sites need no checks of their
+ * own when tracing is off.
+ */
+class ScopedStartupSpan
+{
+    private:
+        StartupTracer *tracer;
+        const char *phase, *asset;
+        double start_us;
+        long long bytes = -1;
+
+    public:
+        ScopedStartupSpan(StartupTracer *tracer, const char *phase, const char *asset = nullptr)
+            : tracer(tracer), phase(phase), asset(asset), start_us(tracer != nullptr ? tracer->now() : 0.0) {}
+
+        ~ScopedStartupSpan()
+        {
+            if (this->tracer != nullptr) this->tracer->record(this->phase, this->asset, this->start_us, this->tracer->now(), this->bytes);
+        }
+
+        void set_bytes(long long bytes)
+        {
+            this->bytes = bytes;
+        }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+#include "StartupTracer.h"
+
+// RGBA8 pixels as returned by stbi_load, rows top to bottom
+struct DecodedImage
+{
+    int width = 0,
+        height = 0;
+    const unsigned char *pixels = nullptr;
+};
+
+inline bool read_file(const char *filepath, std::vector<unsigned char> &contents)
+{
+    FILE *file = std::fopen(filepath, "rb");
+    if (file == nullptr) return false;
+
+    std::fseek(file, 0, SEEK_END);
+    contents.resize(std::ftell(file));
+    std::fseek(file, 0, SEEK_SET);
+    bool read = std::fread(contents.data(), 1, contents.size(), file) == contents.size();
+    std::fclose(file);
+
+    return read;
+}
+
+/**
+ * Decodes an image already in memory, such as an embedded PNG, to RGBA8.
+ * Safe to call from several threads at once: the bundled stb_image keeps
+ * no state between calls beyond its thread-local failure reason.
+ *
+ * @return The image, whose pixels must be released with stbi_image_free, or
+ *         one with null pixels if it could not be decoded.
+ */
+inline DecodedImage decode_image_memory(const unsigned char *data, size_t size, const char *name,
+                                        StartupTracer *tracer = nullptr)
+{
+    DecodedImage image;
+
+    ScopedStartupSpan span(tracer, "decode", name);
+    int number_of_components;
+    image.pixels = stbi_load_from_memory(data, (int) size, &image.width, &image.height,
+                                         &number_of_components, STBI_rgb_alpha);
+    if (image.pixels != nullptr) span.set_bytes((long long) image.width * image.height * 4);
+
+    return image;
+}
+
+/**
+ * Decodes an image file to RGBA8. Needs no GL, so it can run on any thread.
+ * The file is read whole and then decoded from memory, so a tracer can tell
+ * I/O and decoding apart.
+ *
+ * @return The image, whose pixels must be released with stbi_image_free, or
+ *         one with null pixels if the file could not be loaded.
+ */
+inline DecodedImage decode_image_file(const char *filepath, StartupTracer *tracer = nullptr)
+{
+    DecodedImage image;
+    std::vector<unsigned char> contents;
+
+    {
+        ScopedStartupSpan span(tracer, "read", filepath);
+        if (!read_file(filepath, contents)) return image;
+        span.set_bytes(contents.size());
+    }
+
+    return decode_image_memory(contents.data(), contents.size(), filepath, tracer);
+}
@@ -0,0 +1,344 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAS_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRACE_HAS_TSC
+#endif
+
+/**
+ * Session-long trace of the game loop: scoped zones, counters and instant
+ * events, written as Chrome trace JSON for chrome://tracing or
+ * ui.perfetto.dev.
+ *
+ * Each thread records into its own ring, which only it writes and only the
+ * draining thread reads, so recording never takes a lock or allocates after
+ * the thread's first event. drain() streams whatever the rings hold to the
+ * file; a ring that fills up before it is drained drops new events and
+ * counts them.
+ *
+ * Timestamps are raw time stamp counter ticks on x86, which are several
+ * times cheaper to read than the steady clock, and are converted to
+ * microseconds when drained by comparing both clocks against the start.
+ *
+ * The TRACE_* macros compile to nothing unless PONG_TRACE is defined. With
+ * it defined but no trace started, a zone costs one relaxed load. While
+ * recording, counters and instants read the clock once and a zone twice,
+ * at its start and end, so bench/trace_bench.cpp budgets a zone as two
+ * events. Names
+ * must be string literals, since only the pointer is recorded.
+ */
+class TraceRecorder
+{
+    public:
+        static constexpr uint32_t RING_CAPACITY = 1 << 14; // events per thread, a power of two
+
+    private:
+        enum EventType : uint32_t { ZONE, COUNTER, INSTANT };
+
+        struct Event
+        {
+            const char *name;
+            int64_t start;
+            union
+            {
+                int64_t duration;    // ZONE
+                double value;        // COUNTER
+            };
+            EventType type;
+        };
+
+        // Single producer (its thread), single consumer (whoever drains)
+        struct Ring
+        {
+            Event events[RING_CAPACITY];
+            std::atomic<uint32_t> head{0},
+                                  tail{0};
+            std::atomic<const char*> name{nullptr};
+            std::atomic<uint64_t> dropped{0};
+            int thread = 0;
+        };
+
+        /**
+         * The recording side of this thread's ring. Its write index and the
+         * last tail it saw live here rather than in the shared ring, so
+         * recording an event only reads the drainer's tail when the ring
+         * looks full, and only writes the shared head to publish.
+         */
+        struct Writer
+        {
+            Ring *ring = nullptr;
+            uint32_t head = 0,
+                     tail = 0;
+
+            // The slot to fill next, or nullptr if the ring is full
+            Event* reserve()
+            {
+                if (this->ring == nullptr) this->ring = get().register_thread();
+
+                if (this->head - this->tail == RING_CAPACITY)
+                {
+                    this->tail = this->ring->tail.load(std::memory_order_acquire);
+                    if (this->head - this->tail == RING_CAPACITY)
+                    {
+                        this->ring->dropped.store(this->ring->dropped.load(std::memory_order_relaxed) + 1,
+                                                  std::memory_order_relaxed);
+                        return nullptr;
+                    }
+                }
+                return &this->ring->events[this->head & (RING_CAPACITY - 1)];
+            }
+
+            void publish()
+            {
+                this->ring->head.store(++this->head, std::memory_order_release);
+            }
+        };
+
+        // Constant-initialised, so reaching it costs no guard or wrapper call
+        static thread_local Writer writer;
+
+        static inline std::atomic<bool> recording{false}; // static, so checking it skips get()'s guard
+        std::mutex mutex; // guards the ring list and the file, never taken to record
+        std::vector<std::unique_ptr<Ring>> rings;
+        FILE *file = nullptr;
+        int64_t origin_ticks = 0,
+                origin_ns = 0;
+        double microseconds_per_tick = 0.001;
+        bool first_event = true;
+
+        Ring* register_thread()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->rings.emplace_back(new Ring());
+            this->rings.back()->thread = (int) this->rings.size();
+            return this->rings.back().get();
+        }
+
+        static int64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void write_event_start(const char *phase, int thread, int64_t start, const char *name)
+        {
+            std::fprintf(this->file, "%s\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"name\":\"%s\"",
+                         this->first_event ? "" : ",", phase, thread,
+                         (start - this->origin_ticks) * this->microseconds_per_tick, name);
+            this->first_event = false;
+        }
+
+        void drain_ring(Ring &ring)
+        {
+            uint32_t tail = ring.tail.load(std::memory_order_relaxed),
+                     head = ring.head.load(std::memory_order_acquire);
+
+            for (; tail != head; tail++)
+            {
+                const Event &event = ring.events[tail & (RING_CAPACITY - 1)];
+                switch (event.type)
+                {
+                    case ZONE:
+                        this->write_event_start("X", ring.thread, event.start, event.name);
+                        std::fprintf(this->file, ",\"dur\":%.3f}", event.duration * this->microseconds_per_tick);
+                        break;
+                    case COUNTER:
+                        this->write_event_start("C", ring.thread, event.start, event.name);
+                        std::fprintf(this->file, ",\"args\":{\"value\":%g}}", event.value);
+                        break;
+                    case INSTANT:
+                        this->write_event_start("i", ring.thread, event.start, event.name);
+                        std::fprintf(this->file, ",\"s\":\"t\"}");
+                        break;
+                }
+            }
+
+            // Hands the slots back to the producer only once they have been read
+            ring.tail.store(tail, std::memory_order_release);
+        }
+
+    public:
+        static TraceRecorder& get()
+        {
+            static TraceRecorder recorder;
+            return recorder;
+        }
+
+        // Time stamp counter ticks where there is one, else steady clock nanoseconds
+        static int64_t now()
+        {
+#ifdef TRACE_HAS_TSC
+            return (int64_t) __rdtsc();
+#else
+            return now_ns();
+#endif
+        }
+
+        static bool is_recording()
+        {
+            return recording.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Opens the trace file and starts recording, with timestamps relative
+         * to now.
+         *
+         * @return Whether the file could be created.
+         */
+        bool start(const char *filepath)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+
+            this->file = std::fopen(filepath, "w");
+            if (this->file == nullptr) return false;
+
+            std::fprintf(this->file, "{\"traceEvents\":[");
+            this->origin_ticks = now();
+            this->origin_ns = now_ns();
+            this->recording.store(true, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Writes out everything recorded so far; call from one thread only
+        void drain()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->file == nullptr) return;
+
+#ifdef TRACE_HAS_TSC
+            // The longer the trace runs, the more exact the tick rate gets
+            int64_t ticks = now() - this->origin_ticks,
+                    nanoseconds = now_ns() - this->origin_ns;
+            if (ticks > 0 && nanoseconds > 0) this->microseconds_per_tick = nanoseconds / 1000.0 / ticks;
+#endif
+
+            for (const std::unique_ptr<Ring> &ring : this->rings) this->drain_ring(*ring);
+        }
+
+        /**
+         * Stops recording, drains and closes the file. Threads still recording
+         * are not waited for, so stop them first for a complete trace.
+         *
+         * @return Whether the whole file could be written.
+         */
+        bool stop()
+        {
+            this->recording.store(false, std::memory_order_relaxed);
+            this->drain();
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->file == nullptr) return false;
+
+            for (const std::unique_ptr<Ring> &ring : this->rings)
+            {
+                const char *name = ring->name.load(std::memory_order_relaxed);
+                if (name != nullptr)
+                {
+                    std::fprintf(this->file, "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                                 this->first_event ? "" : ",", ring->thread, name);
+                    this->first_event = false;
+                }
+
+                uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+                if (dropped > 0) std::fprintf(stderr, "Trace: dropped %llu events on thread %d\n", (unsigned long long) dropped, ring->thread);
+            }
+            std::fprintf(this->file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+            bool written = std::fclose(this->file) == 0;
+            this->file = nullptr;
+            return written;
+        }
+
+        void set_thread_name(const char *name)
+        {
+            if (writer.ring == nullptr) writer.ring = this->register_thread();
+            writer.ring->name.store(name, std::memory_order_relaxed);
+        }
+
+        // Written straight into the ring, reading the clock only for its end
+        static void zone(const char *name, int64_t start)
+        {
+            int64_t end = now();
+            Event *event = writer.reserve();
+            if (event == nullptr) return;
+
+            event->name = name;
+            event->start = start;
+            event->duration = end - start;
+            event->type = ZONE;
+            writer.publish();
+        }
+
+        void counter(const char *name, double value)
+        {
+            if (!this->is_recording()) return;
+
+            Event *event = writer.reserve();
+            if (event == nullptr) return;
+
+            event->name = name;
+            event->start = now();
+            event->value = value;
+            event->type = COUNTER;
+            writer.publish();
+        }
+
+        void instant(const char *name)
+        {
+            if (!this->is_recording()) return;
+
+            Event *event = writer.reserve();
+            if (event == nullptr) return;
+
+            event->name = name;
+            event->start = now();
+            event->duration = 0;
+            event->type = INSTANT;
+            writer.publish();
+        }
+};
+
+inline thread_local TraceRecorder::Writer TraceRecorder::writer;
+
+// Records the time between construction and destruction as one zone
+class TraceZone
+{
+    private:
+        const char *name;
+        int64_t start;
+
+    public:
+        explicit TraceZone(const char *name)
+            : name(name), start(TraceRecorder::is_recording() ? TraceRecorder::now() : 0) {}
+
+        ~TraceZone()
+        {
+            // A zone that started before recording did is left out
+            if (this->start != 0) TraceRecorder::zone(this->name, this->start);
+        }
+};
+
+#define TRACE_CONCATENATE_INNER(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_INNER(a, b)
+
+#ifdef PONG_TRACE
+#define TRACE_ZONE(name)           TraceZone TRACE_CONCATENATE(trace_zone_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) TraceRecorder::get().counter(name, value)
+#define TRACE_INSTANT(name)        TraceRecorder::get().instant(name)
+#define TRACE_THREAD_NAME(name)    TraceRecorder::get().set_thread_name(name)
+#else
+#define TRACE_ZONE(name)           ((void) 0)
+#define TRACE_COUNTER(name, value) ((void) 0)
+#define TRACE_INSTANT(name)        ((void) 0)
+#define TRACE_THREAD_NAME(name)    ((void) 0)
+#endif
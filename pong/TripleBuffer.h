@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free triple buffer handing values from one producer thread to one
+ * consumer thread.
+ *
+ * The producer fills back() and calls publish(); the consumer calls
+ * consume() and, when it returns true, reads front(). Neither side ever
+ * waits for the other: the producer can publish faster than the consumer
+ * reads (older values are simply skipped) and the consumer keeps its
+ * current value until a newer one is published.
+ */
+template <typename T>
+class TripleBuffer
+{
+    public:
+        static constexpr int SLOT_COUNT = 3;
+
+    private:
+        static constexpr uint8_t INDEX_MASK = 0x3,
+                                 FRESH_BIT  = 0x4;
+
+        T slots[SLOT_COUNT];
+
+        // Slot index shared between both sides, plus whether it holds unread data
+        std::atomic<uint8_t> middle;
+
+        uint8_t back_index = 0,  // only touched by the producer
+                front_index = 2; // only touched by the consumer
+
+    public:
+        TripleBuffer() : middle(1) {}
+
+        // Any slot, for setting them all up before either side starts
+        T& get_slot(int index)
+        {
+            return this->slots[index];
+        }
+
+        T& back()
+        {
+            return this->slots[this->back_index];
+        }
+
+        void publish()
+        {
+            uint8_t previous = this->middle.exchange(this->back_index | FRESH_BIT, std::memory_order_acq_rel);
+            this->back_index = previous & INDEX_MASK;
+        }
+
+        /**
+         * Swaps in the newest published value, if there is one.
+         *
+         * @return Whether front() changed.
+         */
+        bool consume()
+        {
+            if ((this->middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+
+            uint8_t previous = this->middle.exchange(this->front_index, std::memory_order_acq_rel);
+            this->front_index = previous & INDEX_MASK;
+            return true;
+        }
+
+        const T& front() const
+        {
+            return this->slots[this->front_index];
+        }
+};
@@ -19,52 +19,50 @@
 
 #include <SDL.h>
 #include <SDL_opengl.h>
+#include "MathConfig.h"
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "ShaderProgram.h"
 #include "stb_image.h"
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include "pong_lib.h"
+#include "AllocationTracker.h"
+#include "Arena.h"
+#include "AssetBundle.h"
+#include "AssetManager.h"
+#include "FrameProfiler.h"
+#include "FrameSink.h"
+#include "InputSampler.h"
+#include "LatencyTracker.h"
+#include "Offscreen.h"
+#include "ParticleRenderer.h"
+#include "ParticleSystem.h"
+#include "PolicyPlugin.h"
+#include "RenderList.h"
+#include "Replay.h"
+#include "Simulation.h"
+#include "SoftwareRenderer.h"
+#include "StartupTracer.h"
+#include "TraceEvents.h"
+#include "TripleBuffer.h"
 
 enum AppStatus { RUNNING, TERMINATED };
 
-constexpr glm::vec3 WALL_INIT_SCALE = glm::vec3(8.0f, 0.64f, 0.0f),
+MATH_CONSTANT glm::vec3 WALL_INIT_SCALE = glm::vec3(8.0f, 0.64f, 0.0f),
                     SCREEN_INIT_SCALE  = glm::vec3(8.0f, 6.0f, 0.0f);
 
-const glm::mat4 TOP_WALL_MODEL_MATRIX = glm::scale(
-                    glm::translate(
-                        IDENTITY_MATRIX,
-                        glm::vec3(0.0f, 2.67f, 0.0f)
-                    ),
-                    WALL_INIT_SCALE
-                 ),
-                 LOW_WALL_MODEL_MATRIX = glm::scale(
-                    glm::translate(
-                        IDENTITY_MATRIX,
-                        glm::vec3(0.0f, -2.67, 0.0f)
-                    ),
-                    WALL_INIT_SCALE
-                 ),
-                 SCREEN_MODEL_MATRIX = glm::scale(
-                    IDENTITY_MATRIX,
-                    SCREEN_INIT_SCALE 
-                 ),
-                 PLAYER_ONE_SCORE_MODEL_MATRIX = glm::scale(
-                    glm::translate(
-                        IDENTITY_MATRIX,
-                        glm::vec3(-1.72f, 1.83f, 0.0f)
-                    ),
-                    Ball::INIT_SCALE
-                 ),
-                 PLAYER_TWO_SCORE_MODEL_MATRIX = glm::scale(
-                    glm::translate(
-                        IDENTITY_MATRIX,
-                        glm::vec3(1.72f, 1.83f, 0.0f)
-                    ),
-                    Ball::INIT_SCALE
-                 );
+// Sprite transforms: offset in xy, scale in zw
+MATH_CONSTANT glm::vec4 TOP_WALL_TRANSFORM = glm::vec4(0.0f, 2.67f, WALL_INIT_SCALE.x, WALL_INIT_SCALE.y),
+                    LOW_WALL_TRANSFORM = glm::vec4(0.0f, -2.67f, WALL_INIT_SCALE.x, WALL_INIT_SCALE.y),
+                    SCREEN_TRANSFORM   = glm::vec4(0.0f, 0.0f, SCREEN_INIT_SCALE.x, SCREEN_INIT_SCALE.y),
+                    PLAYER_ONE_SCORE_TRANSFORM = glm::vec4(-1.72f, 1.83f, Ball::INIT_SCALE.x, Ball::INIT_SCALE.y),
+                    PLAYER_TWO_SCORE_TRANSFORM = glm::vec4(1.72f, 1.83f, Ball::INIT_SCALE.x, Ball::INIT_SCALE.y);
 
 constexpr int WINDOW_WIDTH  = 960,
               WINDOW_HEIGHT = 720;
@@ -80,10 +78,49 @@ constexpr int VIEWPORT_X      = 0,
               VIEWPORT_HEIGHT = WINDOW_HEIGHT;
 
 constexpr char V_SHADER_PATH[] = "shaders/vertex_textured.glsl",
-               F_SHADER_PATH[] = "shaders/fragment_textured.glsl";
+               F_SHADER_PATH[] = "shaders/fragment_textured.glsl",
+               V_PARTICLE_SHADER_PATH[] = "shaders/vertex_particle.glsl",
+               F_PARTICLE_SHADER_PATH[] = "shaders/fragment_particle.glsl";
+
+MATH_CONSTANT glm::vec4 PARTICLE_COLOUR = glm::vec4(1.0f, 1.0f, 1.0f, 0.8f);
+
+// Chaos mode and the spectator grid draw balls as squares in the colour of whoever hit them last
+MATH_CONSTANT glm::vec4 PLAYER_ONE_BALL_COLOUR = glm::vec4(1.0f, 0.55f, 0.2f, 1.0f),
+                        PLAYER_TWO_BALL_COLOUR = glm::vec4(0.3f, 0.7f, 1.0f, 1.0f);
+
+// Balls keys 1, 2 and 3 serve in chaos mode
+constexpr int CHAOS_SERVES[] = { 1, 100, 10000 };
 
 constexpr float MILLISECONDS_IN_SECOND = 1000.0f;
 
+// Headless frames advance by a fixed step so their output is reproducible
+constexpr float FIXED_DELTA_TIME = 1.0f / 60.0f;
+
+// With a render thread, nothing blocks the simulation, so it is paced instead
+constexpr Uint32 SIMULATION_TICK_MILLISECONDS = 4;
+
+// Keys a replay records, in the order of their bits in ReplayFrame::keys
+constexpr SDL_Keycode REPLAY_KEYS[] = { SDLK_1, SDLK_2, SDLK_3, SDLK_t, SDLK_RETURN };
+constexpr int REPLAY_KEY_COUNT = sizeof(REPLAY_KEYS) / sizeof(REPLAY_KEYS[0]);
+
+// Up and down for each player in turn:
+// - Player 1 -> W, S
+// - Player 2 -> Up, Down
+constexpr SDL_Scancode MOVEMENT_KEYS[] = { SDL_SCANCODE_W, SDL_SCANCODE_S, SDL_SCANCODE_UP, SDL_SCANCODE_DOWN };
+constexpr int MOVEMENT_KEY_COUNT = sizeof(MOVEMENT_KEYS) / sizeof(MOVEMENT_KEYS[0]);
+
+// How often the input thread samples the keyboard (--input-thread)
+constexpr std::chrono::microseconds INPUT_SAMPLE_INTERVAL(1000);
+
+// Paddle direction changes one tick can hold; later ones wait for the next tick
+constexpr int MAX_TICK_INPUTS = 32;
+
+// How often the frame-time histograms are rewritten during a session (--histogram)
+constexpr Uint32 HISTOGRAM_WRITE_INTERVAL_MILLISECONDS = 10000;
+
+// How often the trace rings are written out (--trace); each holds a few seconds of events
+constexpr Uint32 TRACE_DRAIN_INTERVAL_MILLISECONDS = 250;
+
 constexpr GLint NUMBER_OF_TEXTURES = 1, // to be generated, that is
                 LEVEL_OF_DETAIL    = 0, // mipmap reduction image level
                 TEXTURE_BORDER     = 0; // this value MUST be zero
@@ -99,8 +136,15 @@ constexpr char PLAYER_ONE_FILEPATH[] = "content/player_one.png",
                BACKGROUND_FILEPATH[] = "content/background.png",
                NUMBERS_FILEPATH[]    = "content/numbers.png";
 
+// Pre-decoded textures and shader sources, made by tools/bundle_assets.cpp.
+// Whatever it does not contain is loaded from the files above instead.
+constexpr char ASSET_BUNDLE_FILEPATH[] = "content/assets.pak";
+
+constexpr size_t BYTES_IN_KILOBYTE = 1024;
+
 SDL_Window* g_display_window;
-AppStatus g_app_status = RUNNING;
+SDL_GLContext g_gl_context;
+std::atomic<AppStatus> g_app_status(RUNNING);
 ShaderProgram g_shader_program = ShaderProgram();
 
 Paddle *player_one = nullptr, 
@@ -112,66 +156,200 @@ glm::mat4 g_view_matrix,
 
 float g_previous_ticks = 0.0f;
 
-GLuint g_ball_one_texture_id,
-       g_ball_two_texture_id,
-       g_wall_texture_id,
-       g_win_one_texture_id,
-       g_win_two_texture_id,
-       g_background_texture_id,
-       g_numbers_texture_id;
+// Textures load the first time they are drawn; see AssetManager
+AssetManager g_textures;
+TextureHandle g_player_one_texture,
+              g_player_two_texture,
+              g_ball_one_texture,
+              g_ball_two_texture,
+              g_wall_texture,
+              g_win_one_texture,
+              g_win_two_texture,
+              g_background_texture,
+              g_numbers_texture,
+              g_shown_win_texture,  // while a win screen is up
+              g_hidden_win_texture;
+
+AssetBundle g_asset_bundle;
+
+// Startup phase and per-asset timings, written once the first frame is out (--startup-trace)
+StartupTracer *g_startup_tracer = nullptr;
+const char *g_startup_trace_path = nullptr;
 
 bool g_pause = false;
 bool g_won = false;
 
-GLuint load_texture(const char* filepath)
+RenderList g_render_list;
+StaticLayer *g_static_layer = nullptr;
+
+ParticleSystem *g_particles = nullptr;
+ParticleRenderer g_particle_renderer;
+
+// Per-phase CPU and GPU timings, written to g_profile_path at shutdown (--profile)
+FrameProfiler g_profiler;
+GpuTimer g_gpu_timer;
+const char *g_profile_path = nullptr;
+
+// Session-long frame and phase time percentiles, rewritten periodically (--histogram)
+const char *g_histogram_path = nullptr;
+Uint32 g_last_histogram_write = 0;
+
+// Input recording (--record) and playback (--replay); see Replay.h
+Replay g_replay;
+const char *g_record_path = nullptr,
+           *g_replay_path = nullptr;
+int g_replay_tick = 0;
+ReplayFrame g_input_frame; // this tick's input, live or replayed
+PaddleInput g_tick_inputs[MAX_TICK_INPUTS]; // and its g_input_frame.input_count paddle inputs
+
+// Movement keys as of the last key event, in MOVEMENT_KEYS order
+bool g_movement_keys_held[MOVEMENT_KEY_COUNT] = {};
+bool g_skip_render = false;
+
+// Heap allocations per frame and phase, with their call stacks (--allocations);
+// see AllocationTracker.h
+const char *g_allocation_report_path = nullptr;
+bool g_require_no_allocations = false;
+
+// Chaos mode (--chaos N): up to N balls that split on paddle hits and score
+// one by one, in place of the usual one to three
+BallPool *g_chaos_balls = nullptr;
+ChaosRules g_chaos_rules;
+int g_chaos_capacity = 0;
+
+// Spectator view (--arenas N): N CPU-against-CPU matches at once, tiled
+// across the screen in place of the usual one; see Arena.h
+ArenaGrid *g_arenas = nullptr;
+int g_arena_count = 0;
+
+// Player two played by a paddle policy, built in or from a plugin (--policy);
+// see PaddlePolicy.h and pong_policy.h
+const char *g_policy_argument = nullptr;
+const PaddlePolicy *g_player_two_policy = nullptr;
+PolicyPlugin g_policy_plugin;
+uint32_t g_policy_tick = 0;
+
+// Running hash of the match after every tick, printed on exit (--digest)
+bool g_print_digest = false;
+uint64_t g_match_hash = MATCH_HASH_SEED;
+
+// Per-stage latency of every paddle input, from key event to swap (--latency), see LatencyTracker.h
+LatencyTracker g_latency;
+const char *g_latency_path = nullptr;
+
+// Zones, counters and instant events of the whole session (--trace), see TraceEvents.h
+const char *g_trace_path = nullptr;
+Uint32 g_last_trace_drain = 0;
+
+// Optional render thread (--render-thread) that owns the GL context and
+// draws the newest render list the simulation has published
+bool g_use_render_thread = false;
+TripleBuffer<RenderList> g_render_lists;
+std::atomic<bool> g_render_thread_running(false);
+std::thread g_render_thread;
+
+// Optional input thread (--input-thread): the main thread, which SDL needs to
+// take events on, samples the keyboard at 1 kHz while the game loop runs on
+// a thread of its own, so a slow frame no longer delays when keys are seen
+bool g_use_input_thread = false;
+InputSampler g_input_sampler;
+
+// Headless rendering, either on the CPU (--software) or into an OpenGL
+// framebuffer that is read back asynchronously (--offscreen)
+bool g_headless = false,
+     g_offscreen = false;
+SoftwareRenderer *g_software_renderer = nullptr;
+FrameReadback *g_frame_readback = nullptr;
+const char *g_frame_output_dir = nullptr;
+int g_frame_limit = 0,
+    g_frame_count = 0;
+
+// Compiles a shader pair from the embedded assets, the asset bundle or disk, in that order
+void load_shader_program(ShaderProgram &shader_program, const char *vertex_shader_file,
+                         const char *fragment_shader_file)
 {
-    // STEP 1: Loading the image file
-    int width, height, number_of_components;
-    unsigned char* image = stbi_load(filepath, &width, &height, &number_of_components, STBI_rgb_alpha);
+    ScopedStartupSpan span(g_startup_tracer, "shader", vertex_shader_file);
+
+    const EmbeddedAsset *embedded_vertex_shader   = find_embedded_asset(vertex_shader_file),
+                        *embedded_fragment_shader = find_embedded_asset(fragment_shader_file);
 
-    if (image == NULL)
+    if (embedded_vertex_shader != nullptr && embedded_fragment_shader != nullptr)
     {
-        LOG("Unable to load image. Make sure the path is correct.");
-        assert(false);
+        shader_program.load_from_source((const char*) embedded_vertex_shader->data, (int) embedded_vertex_shader->size,
+                                        (const char*) embedded_fragment_shader->data, (int) embedded_fragment_shader->size);
+        return;
     }
 
-    // STEP 2: Generating and binding a texture ID to our image
-    GLuint textureID;
-    glGenTextures(NUMBER_OF_TEXTURES, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, image);
+    const AssetEntry *vertex_shader   = g_asset_bundle.find(vertex_shader_file, ASSET_SHADER_SOURCE),
+                     *fragment_shader = g_asset_bundle.find(fragment_shader_file, ASSET_SHADER_SOURCE);
 
-    // STEP 3: Setting our texture filter parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (vertex_shader == nullptr || fragment_shader == nullptr)
+    {
+        shader_program.load(vertex_shader_file, fragment_shader_file);
+        return;
+    }
+
+    shader_program.load_from_source((const char*) g_asset_bundle.get_data(*vertex_shader), (int) vertex_shader->size,
+                                    (const char*) g_asset_bundle.get_data(*fragment_shader), (int) fragment_shader->size);
+}
 
-    // STEP 4: Releasing our file from memory and returning our texture id
-    stbi_image_free(image);
+void write_frame(const uint8_t *rgba, int width, int height, bool bottom_up, int frame_index)
+{
+    if (g_frame_output_dir == nullptr) return;
 
-    return textureID;
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s/frame_%05d.ppm", g_frame_output_dir, frame_index);
+
+    if (!write_ppm(filepath, rgba, width, height, bottom_up)) LOG("Unable to write frame " << filepath);
 }
 
-void initialise()
+void initialise_video()
 {
-    // Initialize random generator
-    srand(time(NULL));
+    Uint32 window_flags = SDL_WINDOW_OPENGL;
 
-    // Initialise video
-    SDL_Init(SDL_INIT_VIDEO);
+    if (g_offscreen)
+    {
+#ifdef PONG_USE_EGL
+        ScopedStartupSpan span(g_startup_tracer, "context");
 
-    g_display_window = SDL_CreateWindow("Pong Clone",
-                                      SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                                      WINDOW_WIDTH, WINDOW_HEIGHT,
-                                      SDL_WINDOW_OPENGL);
+        // No window at all; SDL is only needed for its timer
+        SDL_Init(SDL_INIT_TIMER);
 
-    SDL_GLContext context = SDL_GL_CreateContext(g_display_window);
-    SDL_GL_MakeCurrent(g_display_window, context);
+        if (!create_egl_context())
+        {
+            std::cerr << "Error: EGL context could not be created.\n";
+            SDL_Quit();
+            exit(1);
+        }
+#else
+        // Without EGL, a hidden window provides the context
+        window_flags |= SDL_WINDOW_HIDDEN;
+#endif
+    }
 
-    if (g_display_window == nullptr)
+#ifdef PONG_USE_EGL
+    if (!g_offscreen)
+#endif
     {
-        std::cerr << "Error: SDL window could not be created.\n";
-        SDL_Quit();
-        exit(1);
+        ScopedStartupSpan span(g_startup_tracer, "context");
+
+        // Initialise video
+        SDL_Init(SDL_INIT_VIDEO);
+
+        g_display_window = SDL_CreateWindow("Pong Clone",
+                                          SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                          WINDOW_WIDTH, WINDOW_HEIGHT,
+                                          window_flags);
+
+        g_gl_context = SDL_GL_CreateContext(g_display_window);
+        SDL_GL_MakeCurrent(g_display_window, g_gl_context);
+
+        if (g_display_window == nullptr)
+        {
+            std::cerr << "Error: SDL window could not be created.\n";
+            SDL_Quit();
+            exit(1);
+        }
     }
 
 #ifdef _WINDOWS
@@ -180,7 +358,7 @@ void initialise()
 
     glViewport(VIEWPORT_X, VIEWPORT_Y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
 
-    g_shader_program.load(V_SHADER_PATH, F_SHADER_PATH);
+    load_shader_program(g_shader_program, V_SHADER_PATH, F_SHADER_PATH);
 
     g_view_matrix       = IDENTITY_MATRIX;
     g_projection_matrix = glm::ortho(-4.0f, 4.0f, -3.0f, 3.0f, -1.0f, 1.0f);
@@ -192,197 +370,448 @@ void initialise()
 
     glClearColor(BG_RED, BG_BLUE, BG_GREEN, BG_OPACITY);
 
-    g_ball_one_texture_id   = load_texture(BALL_ONE_FILEPATH);
-    g_ball_two_texture_id   = load_texture(BALL_TWO_FILEPATH);
-    g_win_one_texture_id    = load_texture(WIN_ONE_FILEPATH);
-    g_win_two_texture_id    = load_texture(WIN_TWO_FILEPATH);
-    g_wall_texture_id       = load_texture(WALL_FILEPATH);
-    g_background_texture_id = load_texture(BACKGROUND_FILEPATH);
-    g_numbers_texture_id    = load_texture(NUMBERS_FILEPATH);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    {
+        ScopedStartupSpan span(g_startup_tracer, "render_targets");
+
+        if (g_offscreen) g_frame_readback = new FrameReadback(WINDOW_WIDTH, WINDOW_HEIGHT, write_frame);
+
+        g_static_layer = new StaticLayer(WINDOW_WIDTH, WINDOW_HEIGHT);
+    }
+
+    ShaderProgram particle_shader_program;
+    load_shader_program(particle_shader_program, V_PARTICLE_SHADER_PATH, F_PARTICLE_SHADER_PATH);
+    g_particle_renderer.load(particle_shader_program, g_view_matrix, g_projection_matrix);
+
+    if (g_profile_path != nullptr) g_gpu_timer.initialise();
+}
+
+void initialise()
+{
+    // Initialize random generator, with the recorded seed when replaying
+    if (g_replay_path == nullptr) g_replay.set_seed((unsigned int) time(NULL));
+    srand(g_replay.get_seed());
+
+    {
+        ScopedStartupSpan span(g_startup_tracer, "bundle_open", ASSET_BUNDLE_FILEPATH);
+        if (g_asset_bundle.open(ASSET_BUNDLE_FILEPATH)) g_textures.set_bundle(&g_asset_bundle);
+    }
+    g_textures.set_tracer(g_startup_tracer);
+
+    g_player_one_texture = g_textures.acquire(PLAYER_ONE_FILEPATH);
+    g_player_two_texture = g_textures.acquire(PLAYER_TWO_FILEPATH);
+    g_ball_one_texture   = g_textures.acquire(BALL_ONE_FILEPATH);
+    g_ball_two_texture   = g_textures.acquire(BALL_TWO_FILEPATH);
+    g_win_one_texture    = g_textures.acquire(WIN_ONE_FILEPATH);
+    g_win_two_texture    = g_textures.acquire(WIN_TWO_FILEPATH);
+    g_wall_texture       = g_textures.acquire(WALL_FILEPATH);
+    g_background_texture = g_textures.acquire(BACKGROUND_FILEPATH);
+    g_numbers_texture    = g_textures.acquire(NUMBERS_FILEPATH);
+
+    // Everything but the win screens is drawn on the first frame, so it is
+    // decoded in the background while the window and context are created
+    for (TextureHandle texture : { g_player_one_texture, g_player_two_texture, g_ball_one_texture, g_ball_two_texture,
+                                   g_wall_texture, g_background_texture, g_numbers_texture })
+    {
+        g_textures.prefetch(texture);
+    }
+
+    if (g_software_renderer != nullptr)
+    {
+        // No window or GL context; SDL is only needed for its timer
+        SDL_Init(SDL_INIT_TIMER);
+
+        g_view_matrix       = IDENTITY_MATRIX;
+        g_projection_matrix = glm::ortho(-4.0f, 4.0f, -3.0f, 3.0f, -1.0f, 1.0f);
+
+        g_software_renderer->set_view_projection_matrix(g_projection_matrix * g_view_matrix);
+    }
+    else
+    {
+        ScopedStartupSpan span(g_startup_tracer, "video");
+        initialise_video();
+    }
+
+    g_textures.create_texture_names(g_software_renderer);
 
     player_one = new Paddle(
         -Paddle::INIT_POS,
-        load_texture(PLAYER_ONE_FILEPATH)
+        g_textures.get_texture_id(g_player_one_texture)
     );
     player_two = new Paddle(
         Paddle::INIT_POS,
-        load_texture(PLAYER_TWO_FILEPATH)
+        g_textures.get_texture_id(g_player_two_texture)
     );
+    if (g_player_two_policy != nullptr) assign_policy(player_two, *g_player_two_policy);
+
+    ScopedStartupSpan span(g_startup_tracer, "objects");
 
     balls = new Ball[Ball::MAX_AMOUNT];
     balls[0].enable();
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (g_chaos_capacity > 0)
+    {
+        g_chaos_balls = new BallPool(g_chaos_capacity);
+        g_chaos_balls->spawn(Ball());
+    }
+
+    if (g_arena_count > 0)
+    {
+        g_arenas = new ArenaGrid(g_arena_count);
+        g_arenas->set_policy(g_player_two_policy);
+    }
+
+    g_particles = new ParticleSystem();
+
+    int max_instances = std::max(g_particles->get_capacity(), g_chaos_capacity);
+    if (g_arenas != nullptr) max_instances = std::max(max_instances, g_arenas->get_max_batch_instances());
+    g_render_list.reserve_instances(max_instances);
+    for (int i = 0; i < TripleBuffer<RenderList>::SLOT_COUNT; i++)
+    {
+        g_render_lists.get_slot(i).reserve_instances(max_instances);
+    }
 }
 
-void process_input()
+// Carries out one of the REPLAY_KEYS
+void press_key(SDL_Keycode key)
 {
-    SDL_Event event;
-    while (SDL_PollEvent(&event))
+    // Chaos mode serves more balls instead, and there is no winner to wait on
+    if (g_chaos_balls != nullptr && !g_pause)
     {
-        switch (event.type)
+        for (int i = 0; i < 3; i++)
         {
-            // End game
-            case SDL_QUIT:
-            case SDL_WINDOWEVENT_CLOSE:
-                g_app_status = TERMINATED;
-                break;
-            case SDL_KEYDOWN:
-                switch (event.key.keysym.sym)
+            if (key != SDLK_1 + i) continue;
+            for (int serve = 0; serve < CHAOS_SERVES[i]; serve++) g_chaos_balls->spawn(Ball());
+            return;
+        }
+    }
+
+    // The spectator grid's ball keys set up every arena at once
+    if (g_arenas != nullptr && !g_pause && key >= SDLK_1 && key <= SDLK_3)
+    {
+        g_arenas->set_ball_count(key - SDLK_1 + 1);
+        return;
+    }
+
+    switch (key)
+    {
+        case SDLK_3:
+            // Set up three balls
+            if (!g_pause)
+            {
+                for (int i = 0; i < Ball::MAX_AMOUNT; i++)
                 {
-                    case SDLK_q: 
-                        g_app_status = TERMINATED;
-                        break;
-                    case SDLK_3:
-                        // Set up three balls
-                        if (!g_pause)
-                        {
-                            for (int i = 0; i < Ball::MAX_AMOUNT; i++)
-                            {
-                                balls[i].reset();
-                                balls[i].enable();
-                            }
-                        }
-                        break;
-                    case SDLK_2:
-                        // Set up two balls
-                        if (!g_pause)
-                        {
-                            for (int i = 0; i < Ball::MAX_AMOUNT - 1; i++)
-                            {
-                                balls[i].reset();
-                                balls[i].enable();
-                            }
-                            balls[2].disable();
-                        }
-                        break;
-                    case SDLK_1:
-                        // Set up one ball
-                        if (!g_pause)
-                        {
-                            for (int i = 1; i < Ball::MAX_AMOUNT; i++) balls[i].disable();
-                            balls[0].reset();
-                            balls[0].enable();
-                        }
-                        break;
-                    case SDLK_t:
-                        // Switch Player 2 to CPU mode and start it down
-                        player_two->toggle_playability();
-                        break;
-                    case SDLK_d:
-                        // Print debug information
-                        LOG("Player 1");
-                        LOG(*player_one);
-
-                        LOG("Player 2");
-                        LOG(*player_two);
-
-                        for (int i = 0; i < Ball::MAX_AMOUNT; i++)
-                        {
-                            if (balls[i].get_status())
-                            {
-                                LOG("Ball " << i + 1);
-                                LOG(balls[i]);
-                            }
-                        }
-                        break;
-                    case SDLK_RETURN:
-                        if (g_won)
-                        {
-                            player_one->reset();
-                            player_two->reset();
-                            for (int i = 0; i < Ball::MAX_AMOUNT; i++)
-                            {
-                                balls[i].reset();
-                            }
-                        }
-                        else g_pause = !g_pause;
-                        break;
-                    default: 
-                        break;
+                    balls[i].reset();
+                    balls[i].enable();
                 }
-            default:
-                break;
-        } 
+            }
+            break;
+        case SDLK_2:
+            // Set up two balls
+            if (!g_pause)
+            {
+                for (int i = 0; i < Ball::MAX_AMOUNT - 1; i++)
+                {
+                    balls[i].reset();
+                    balls[i].enable();
+                }
+                balls[2].disable();
+            }
+            break;
+        case SDLK_1:
+            // Set up one ball
+            if (!g_pause)
+            {
+                for (int i = 1; i < Ball::MAX_AMOUNT; i++) balls[i].disable();
+                balls[0].reset();
+                balls[0].enable();
+            }
+            break;
+        case SDLK_t:
+            // Switch Player 2 to CPU mode and start it down
+            player_two->toggle_playability();
+            break;
+        case SDLK_RETURN:
+            if (g_won)
+            {
+                player_one->reset();
+                player_two->reset();
+                for (int i = 0; i < Ball::MAX_AMOUNT; i++)
+                {
+                    balls[i].reset();
+                }
+            }
+            else g_pause = !g_pause;
+            break;
+        default:
+            break;
     }
+}
 
-    const Uint8 *key_state = SDL_GetKeyboardState(NULL);
+// Which way the movement keys held say a player's (1 or 2) paddle goes; up wins over down
+int get_held_direction(int player)
+{
+    if (g_movement_keys_held[2 * (player - 1)])     return 1;
+    if (g_movement_keys_held[2 * (player - 1) + 1]) return -1;
+    return 0;
+}
 
-    // Check up and down movement for keys held down:
-    // - Player 1 -> W, S
-    // - Player 2 -> Up, Down
-    if      (key_state[SDL_SCANCODE_W]) player_one->set_up();
-    else if (key_state[SDL_SCANCODE_S]) player_one->set_down();
-    else                                player_one->set_neutral();
+// Seconds from the start of the tick about to be simulated to an SDL timestamp
+float get_tick_offset(Uint32 timestamp)
+{
+    return std::max(0.0f, (float) timestamp / MILLISECONDS_IN_SECOND - g_previous_ticks);
+}
 
-    if (player_two->get_status())
+// Notes a movement key going down or up at an SDL timestamp, adding a paddle
+// input to this tick if it turns the paddle
+void set_movement_key(ReplayFrame &input, SDL_Scancode scancode, bool held, Uint32 timestamp)
+{
+    for (int key = 0; key < MOVEMENT_KEY_COUNT; key++)
     {
-        if      (key_state[SDL_SCANCODE_UP])   player_two->set_up();
-        else if (key_state[SDL_SCANCODE_DOWN]) player_two->set_down();
-        else                                   player_two->set_neutral();
+        if (MOVEMENT_KEYS[key] != scancode || g_movement_keys_held[key] == held) continue;
+
+        // A policy playing player two has the final say over it
+        int player = key / 2 + 1;
+        if (player == 2 && g_player_two_policy != nullptr) continue;
+
+        int previous_direction = get_held_direction(player);
+        g_movement_keys_held[key] = held;
+
+        int direction = get_held_direction(player);
+        if (direction != previous_direction && input.input_count < MAX_TICK_INPUTS)
+        {
+            g_tick_inputs[input.input_count++] = { get_tick_offset(timestamp), player, direction };
+
+            // SDL timestamps are milliseconds since SDL_Init, on a coarser clock than the tracker's
+            g_latency.input_polled(g_latency.now_ms() - std::max(0, (int) (SDL_GetTicks() - timestamp)));
+        }
     }
 }
 
-void update()
+// Handles a key going down or up, wherever it was sampled
+void handle_key(ReplayFrame &input, SDL_Scancode scancode, SDL_Keycode key, bool down, Uint32 timestamp)
 {
-    // Check and store if either player has won yet
-    g_won = player_one->check_score() || player_two->check_score();
-
-    /* Delta time calculations */
-    float ticks = (float) SDL_GetTicks() / MILLISECONDS_IN_SECOND;
-    float delta_time = ticks - g_previous_ticks;
-    g_previous_ticks = ticks;
+    set_movement_key(input, scancode, down, timestamp);
+    if (!down) return;
 
-    /* Game logic */
-    if (!g_pause && !g_won)
+    switch (key)
     {
-        player_one->update(delta_time);
-        player_two->update(delta_time);
+        case SDLK_q: 
+            g_app_status = TERMINATED;
+            break;
+        case SDLK_d:
+            // Print debug information
+            LOG("Player 1");
+            LOG(*player_one);
 
-        for (int i = 0; i < Ball::MAX_AMOUNT; i++)
-        {
-            if (balls[i].get_status())
+            LOG("Player 2");
+            LOG(*player_two);
+
+            if (g_chaos_balls != nullptr) LOG("Live balls: " << g_chaos_balls->get_live_count());
+            if (g_arenas != nullptr) LOG("Arena matches finished: " << g_arenas->get_matches_finished());
+
+            for (int i = 0; g_chaos_balls == nullptr && i < Ball::MAX_AMOUNT; i++)
             {
-                bool hit_paddle = false;
-                if (balls[i].get_position().x <= 0) 
+                if (balls[i].get_status())
                 {
-                    hit_paddle = balls[i].update(delta_time, player_one);
-                    if (hit_paddle) balls[i].set_player_one();
-                }
-                else
-                {
-                    hit_paddle = balls[i].update(delta_time, player_two);
-                    if (hit_paddle) balls[i].set_player_two();
+                    LOG("Ball " << i + 1);
+                    LOG(balls[i]);
                 }
+            }
+            break;
+        default: 
+            // Game keys take effect after polling, the same way replayed ones do
+            for (int i = 0; i < REPLAY_KEY_COUNT; i++)
+            {
+                if (key == REPLAY_KEYS[i]) input.keys |= 1u << i;
+            }
+            break;
+    }
+}
 
-                if (balls[i].is_out_of_bounds(player_one, player_two))
-                {
-                    for (int j = 0; j < Ball::MAX_AMOUNT; j++) balls[j].reset();
+void process_input()
+{
+    ReplayFrame input;
+
+    // Paddles start the tick going the way the keys held at its start say;
+    // key events then turn them at the moment they happened
+    input.player_one_direction = get_held_direction(1);
+    input.player_two_direction = get_held_direction(2);
+
+    if (g_use_input_thread)
+    {
+        uint32_t held_keys = g_input_sampler.read_sample();
+
+        InputSampler::KeyEvent key_event;
+        while (g_input_sampler.pop(key_event))
+        {
+            handle_key(input, (SDL_Scancode) key_event.scancode, key_event.keycode, key_event.down, key_event.timestamp);
+        }
+
+        // Whatever the ring had no room for still shows in the held keys
+        Uint32 now = SDL_GetTicks();
+        for (int key = 0; key < MOVEMENT_KEY_COUNT; key++)
+        {
+            set_movement_key(input, MOVEMENT_KEYS[key], (held_keys & (1u << key)) != 0, now);
+        }
+    }
+    else
+    {
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            switch (event.type)
+            {
+                // End game
+                case SDL_QUIT:
+                case SDL_WINDOWEVENT_CLOSE:
+                    g_app_status = TERMINATED;
+                    break;
+                case SDL_KEYUP:
+                case SDL_KEYDOWN:
+                    handle_key(input, event.key.keysym.scancode, event.key.keysym.sym, event.type == SDL_KEYDOWN,
+                               event.key.timestamp);
+                    break;
+                default:
                     break;
-                }
             }
         }
 
-        /* Transformations */
-        player_one->update_model_matrix();
-        player_two->update_model_matrix();
-
-        for (int i = 0; i < Ball::MAX_AMOUNT; i++)
+        // Events can go missing, say while the window is out of focus, so the
+        // keyboard state has the final say
+        const Uint8 *key_state = SDL_GetKeyboardState(NULL);
+        Uint32 now = SDL_GetTicks();
+        for (int key = 0; key < MOVEMENT_KEY_COUNT; key++)
         {
-            if (balls[i].get_status()) balls[i].update_model_matrix();
+            set_movement_key(input, MOVEMENT_KEYS[key], key_state[MOVEMENT_KEYS[key]] != 0, now);
         }
     }
+
+    // A replay stands in for the keyboard; quitting still works
+    if (g_replay_path != nullptr)
+    {
+        input = g_replay[g_replay_tick];
+        input.input_count = std::min(input.input_count, MAX_TICK_INPUTS);
+        std::copy(g_replay.get_inputs(g_replay_tick), g_replay.get_inputs(g_replay_tick) + input.input_count, g_tick_inputs);
+
+        // Replayed inputs happen as they are read, so their poll stage is zero
+        for (int i = 0; i < input.input_count; i++) g_latency.input_polled(g_latency.now_ms());
+
+        if (++g_replay_tick == g_replay.size()) g_app_status = TERMINATED;
+    }
+
+    for (int i = 0; i < REPLAY_KEY_COUNT; i++)
+    {
+        if (input.keys & (1u << i)) press_key(REPLAY_KEYS[i]);
+    }
+
+    set_paddle_direction(player_one, input.player_one_direction);
+    if (player_two->get_status() && g_player_two_policy == nullptr)
+    {
+        set_paddle_direction(player_two, input.player_two_direction);
+    }
+
+    g_input_frame = input;
 }
 
-void draw_object(const glm::mat4 &object_g_model_matrix, const GLuint &object_texture_id)
+// References the textures only a match in play draws, or drops them so they are the first to be evicted
+void hold_match_textures(bool held)
 {
-    g_shader_program.set_model_matrix(object_g_model_matrix);
-    glBindTexture(GL_TEXTURE_2D, object_texture_id);
-    glDrawArrays(GL_TRIANGLES, 0, 6); // we are now drawing 2 triangles, so use 6, not 3
+    for (TextureHandle texture : { g_player_one_texture, g_player_two_texture, g_ball_one_texture, g_ball_two_texture,
+                                   g_wall_texture, g_background_texture, g_numbers_texture })
+    {
+        if (held) g_textures.retain(texture);
+        else      g_textures.release(texture);
+    }
 }
 
-void draw_number(const glm::mat4 &number_matrix, int num)
+void update()
+{
+    // Check and store if either player has won yet; chaos matches never end,
+    // and the spectator grid's arenas start over on their own
+    bool has_winner = g_chaos_balls == nullptr && g_arenas == nullptr,
+         was_won    = g_won;
+    g_won = has_winner && (player_one->check_score() || player_two->check_score());
+
+    // A win screen is drawn on its own, so the rest is released until the next match starts
+    if (g_won && !was_won)
+    {
+        g_shown_win_texture  = player_one->check_score() ? g_win_one_texture : g_win_two_texture;
+        g_hidden_win_texture = player_one->check_score() ? g_win_two_texture : g_win_one_texture;
+        hold_match_textures(false);
+        g_textures.release(g_hidden_win_texture);
+    }
+    else if (!g_won && was_won)
+    {
+        hold_match_textures(true);
+        g_textures.retain(g_hidden_win_texture);
+    }
+
+    // One point from the end, the win screens start decoding in the background
+    if (has_winner && std::max(player_one->get_score(), player_two->get_score()) >= FIRST_TO_SCORE - 1)
+    {
+        g_textures.prefetch(g_win_one_texture);
+        g_textures.prefetch(g_win_two_texture);
+    }
+
+    /* Delta time calculations */
+    float ticks = (float) SDL_GetTicks() / MILLISECONDS_IN_SECOND;
+    float delta_time = ticks - g_previous_ticks;
+    g_previous_ticks = ticks;
+
+    if (g_headless) delta_time = FIXED_DELTA_TIME;
+    if (g_replay_path != nullptr) delta_time = g_input_frame.delta_time;
+
+    if (g_record_path != nullptr)
+    {
+        g_input_frame.delta_time = delta_time;
+        g_replay.add(g_input_frame, g_tick_inputs);
+    }
+
+    /* Game logic */
+    if (!g_pause && !g_won && g_arenas == nullptr && g_player_two_policy != nullptr && player_two->get_status())
+    {
+        Ball *observed_balls = g_chaos_balls != nullptr ? g_chaos_balls->get_balls() : balls;
+        int   observed_count = g_chaos_balls != nullptr ? g_chaos_balls->get_live_count() : Ball::MAX_AMOUNT;
+        PaddleObservation observation = observe(player_two, player_one, observed_balls, observed_count, g_policy_tick++);
+
+        int32_t direction = 0;
+        decide_batch(*g_player_two_policy, &observation, 1, &direction);
+        set_paddle_direction(player_two, direction);
+    }
+
+    if (!g_pause && g_arenas != nullptr) g_arenas->update(delta_time);
+    else if (!g_pause && !g_won && g_chaos_balls != nullptr)
+    {
+        update_chaos(delta_time, player_one, player_two, *g_chaos_balls, g_particles, g_chaos_rules,
+                     g_tick_inputs, g_input_frame.input_count);
+    }
+    else if (!g_pause && !g_won)
+    {
+        update_match(delta_time, player_one, player_two, balls, Ball::MAX_AMOUNT, g_particles,
+                     g_tick_inputs, g_input_frame.input_count);
+    }
+    g_latency.inputs_applied();
+
+    if (g_print_digest && g_arenas != nullptr)
+    {
+        for (int i = 0; i < g_arenas->size(); i++)
+        {
+            Arena &arena = (*g_arenas)[i];
+            g_match_hash = hash_match(g_match_hash, &arena.player_one, &arena.player_two, arena.balls, Ball::MAX_AMOUNT);
+        }
+    }
+    else if (g_print_digest && g_chaos_balls != nullptr)
+    {
+        g_match_hash = hash_match(g_match_hash, player_one, player_two, g_chaos_balls->get_balls(),
+                                  g_chaos_balls->get_live_count());
+    }
+    else if (g_print_digest) g_match_hash = hash_match(g_match_hash, player_one, player_two, balls, Ball::MAX_AMOUNT);
+}
+
+glm::vec4 number_texture_rect(int num)
 {
     int cols = 10;
     int rows = 1;
@@ -393,31 +822,122 @@ void draw_number(const glm::mat4 &number_matrix, int num)
     float width = 1.0f / (float) cols;
     float height = 1.0f / (float) rows;
 
+    return glm::vec4(u_coord, v_coord, u_coord + width, v_coord + height);
+}
+
+// Pushes a score's digits centred on a transform, one digit wide each
+void push_score(RenderList &list, const glm::vec4 &transform, int score, GLuint numbers_texture_id)
+{
+    int digits = 1;
+    for (int rest = score / 10; rest > 0; rest /= 10) digits++;
+
+    glm::vec4 digit_transform = transform;
+    digit_transform.x += 0.5f * (digits - 1) * transform.z;
+    for (int i = 0; i < digits; i++, score /= 10, digit_transform.x -= transform.z)
+    {
+        list.push(digit_transform, numbers_texture_id, number_texture_rect(score % 10));
+    }
+}
+
+void build_render_list(RenderList &list)
+{
+    list.clear();
+    list.set_input_sequence(g_latency.get_applied_sequence());
+
+    if (g_won)
+    {
+        if (player_one->check_score())
+        {
+            list.push(SCREEN_TRANSFORM, g_textures.get_texture_id(g_win_one_texture));
+        }
+        else
+        {
+            list.push(SCREEN_TRANSFORM, g_textures.get_texture_id(g_win_two_texture));
+        }
+        list.mark_static();
+    }
+    else if (g_arenas != nullptr)
+    {
+        list.push(SCREEN_TRANSFORM, g_textures.get_texture_id(g_background_texture));
+        list.mark_static();
+
+        g_arenas->push_instances(list, PLAYER_ONE_BALL_COLOUR, PLAYER_TWO_BALL_COLOUR);
+    }
+    else
+    {
+        // The background and walls never move, so they make up the static layer
+        GLuint wall_texture_id    = g_textures.get_texture_id(g_wall_texture),
+               numbers_texture_id = g_textures.get_texture_id(g_numbers_texture);
+
+        list.push(SCREEN_TRANSFORM, g_textures.get_texture_id(g_background_texture));
+        list.push(TOP_WALL_TRANSFORM, wall_texture_id);
+        list.push(LOW_WALL_TRANSFORM, wall_texture_id);
+        list.mark_static();
+
+        push_score(list, PLAYER_ONE_SCORE_TRANSFORM, player_one->get_score(), numbers_texture_id);
+        push_score(list, PLAYER_TWO_SCORE_TRANSFORM, player_two->get_score(), numbers_texture_id);
+
+        list.push(player_one->get_transform(), player_one->get_texture_id());
+        list.push(player_two->get_transform(), player_two->get_texture_id());
+
+        for (int i = 0; g_chaos_balls == nullptr && i < Ball::MAX_AMOUNT; i++)
+        {
+            if (balls[i].get_status())
+            {
+                list.push(balls[i].get_transform(),
+                          g_textures.get_texture_id(balls[i].get_owner() ? g_ball_one_texture
+                                                                         : g_ball_two_texture)
+                );
+            }
+        }
+
+        list.add_batch(g_particles->get_instances(), g_particles->get_instance_count(), PARTICLE_COLOUR);
+
+        // Far too many for sprites, chaos mode's balls go in one instanced batch per player
+        if (g_chaos_balls != nullptr)
+        {
+            std::vector<glm::vec4> *player_one_balls = list.add_batch(PLAYER_ONE_BALL_COLOUR),
+                                   *player_two_balls = list.add_batch(PLAYER_TWO_BALL_COLOUR);
+            for (int i = 0; i < g_chaos_balls->get_live_count(); i++)
+            {
+                Ball &ball = (*g_chaos_balls)[i];
+                const glm::vec4 &transform = ball.get_transform();
+                std::vector<glm::vec4> *batch = ball.get_owner() ? player_one_balls : player_two_balls;
+                batch->push_back(glm::vec4(transform.x, transform.y, transform.z, 1.0f));
+            }
+        }
+    }
+}
+
+void draw_object(const Sprite &sprite)
+{
+    // Textures
+    const glm::vec4 &rect = sprite.texture_rect;
     float texture_coordinates[] =
     {
         // Triangle 1
-        u_coord, v_coord + height,         // Lower left
-        u_coord + width, v_coord + height, // Lower right
-        u_coord + width, v_coord,          // Upper right
+        rect.x, rect.w, // Lower left
+        rect.z, rect.w, // Lower right
+        rect.z, rect.y, // Upper right
         // Triangle 2
-        u_coord, v_coord + height,         // Lower left
-        u_coord + width, v_coord,          // Upper right
-        u_coord, v_coord                   // Upper left
+        rect.x, rect.w, // Lower left
+        rect.z, rect.y, // Upper right
+        rect.x, rect.y  // Upper left
     };
 
-    // Set new texture coordinates
     glVertexAttribPointer(g_shader_program.get_tex_coordinate_attribute(), 2, GL_FLOAT, false,
                           0, texture_coordinates);
-    glEnableVertexAttribArray(g_shader_program.get_tex_coordinate_attribute());
 
-    g_shader_program.set_model_matrix(number_matrix);
-    glBindTexture(GL_TEXTURE_2D, g_numbers_texture_id);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    g_shader_program.set_model_transform(sprite.transform);
+    glBindTexture(GL_TEXTURE_2D, sprite.texture_id);
+    glDrawArrays(GL_TRIANGLES, 0, 6); // we are now drawing 2 triangles, so use 6, not 3
 }
 
-void render()
+void render_gl(const RenderList &list)
 {
-    glClear(GL_COLOR_BUFFER_BIT);
+    g_textures.prepare(list);
+
+    if (g_profile_path != nullptr) g_gpu_timer.begin(g_profiler);
 
     // Vertices
     float vertices[] =
@@ -432,96 +952,526 @@ void render()
         -0.5f, 0.5f   // Upper left
     };
 
-    // Textures
-    float texture_coordinates[] =
-    {
-        // Triangle 1
-        0.0f, 1.0f, // Lower left
-        1.0f, 1.0f, // Lower right
-        1.0f, 0.0f, // Upper right
-        // Triangle 2
-        0.0f, 1.0f, // Lower left
-        1.0f, 0.0f, // Upper right
-        0.0f, 0.0f, // Upper left
-    };
-
     glVertexAttribPointer(g_shader_program.get_position_attribute(), 2, GL_FLOAT, false,
                           0, vertices);
     glEnableVertexAttribArray(g_shader_program.get_position_attribute());
 
-    glVertexAttribPointer(g_shader_program.get_tex_coordinate_attribute(), 2, GL_FLOAT,
-                          false, 0, texture_coordinates);
     glEnableVertexAttribArray(g_shader_program.get_tex_coordinate_attribute());
 
-    // Bind texture
-    if (g_won)
+    // Composite the static layer only when its sprites have changed
+    if (!g_static_layer->is_valid_for(list))
+    {
+        g_static_layer->begin_update(list);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (int i = 0; i < list.get_static_count(); i++) draw_object(list[i]);
+    }
+
+    if (g_frame_readback != nullptr) g_frame_readback->bind();
+    else                             glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // The layer covers the whole viewport, so copying it in replaces clearing
+    glDisable(GL_BLEND);
+    draw_object({ SCREEN_TRANSFORM, g_static_layer->get_texture_id(), StaticLayer::TEXTURE_RECT });
+    glEnable(GL_BLEND);
+
+    for (int i = list.get_static_count(); i < list.size(); i++) draw_object(list[i]);
+
+    // We disable two attribute arrays now
+    glDisableVertexAttribArray(g_shader_program.get_position_attribute());
+    glDisableVertexAttribArray(g_shader_program.get_tex_coordinate_attribute());
+
+    for (int i = 0; i < list.get_batch_count(); i++)
     {
-        if (player_one->check_score()) 
+        const RenderList::InstanceBatch &batch = list.get_batch(i);
+        g_particle_renderer.draw(batch.instances.data(), (int) batch.instances.size(), batch.colour, batch.shape);
+    }
+    glUseProgram(g_shader_program.get_program_id());
+
+    if (g_frame_readback != nullptr) g_frame_readback->capture(g_frame_count);
+
+    if (g_profile_path != nullptr) g_gpu_timer.end();
+}
+
+void present()
+{
+    if (g_frame_readback != nullptr) return;
+
+    ScopedCpuTimer timer(g_profiler, PHASE_SWAP);
+    TRACE_ZONE("present");
+    ALLOCATION_PHASE(PHASE_SWAP);
+    SDL_GL_SwapWindow(g_display_window);
+}
+
+void render_software(const RenderList &list)
+{
+    g_textures.prepare(list);
+
+    g_software_renderer->render(list, BG_RED, BG_GREEN, BG_BLUE, BG_OPACITY);
+
+    write_frame((const uint8_t*) g_software_renderer->get_pixels(), g_software_renderer->get_width(),
+                g_software_renderer->get_height(), false, g_frame_count);
+}
+
+void render_thread_main()
+{
+    SDL_GL_MakeCurrent(g_display_window, g_gl_context);
+    TRACE_THREAD_NAME("render");
+
+    while (g_render_thread_running.load(std::memory_order_acquire))
+    {
+        if (!g_render_lists.consume())
         {
-            draw_object(SCREEN_MODEL_MATRIX, g_win_one_texture_id);
+            SDL_Delay(1);
+            continue;
         }
-        else
+
         {
-            draw_object(SCREEN_MODEL_MATRIX, g_win_two_texture_id);
+            ScopedCpuTimer timer(g_profiler, PHASE_RENDER);
+            TRACE_ZONE("render");
+            ALLOCATION_PHASE(PHASE_RENDER);
+            render_gl(g_render_lists.front());
         }
+        g_latency.frame_drawn(g_render_lists.front().get_input_sequence());
+
+        // Swapping may block on vsync here without holding up the simulation
+        present();
+        g_profiler.frame_presented();
+        g_latency.frame_presented();
     }
-    else
-    {
-        draw_object(SCREEN_MODEL_MATRIX, g_background_texture_id);
 
-        draw_number(PLAYER_ONE_SCORE_MODEL_MATRIX, player_one->get_score());
-        draw_number(PLAYER_TWO_SCORE_MODEL_MATRIX, player_two->get_score());
+    SDL_GL_MakeCurrent(g_display_window, nullptr);
+}
 
-        // Reset original texture coordinates
-        glVertexAttribPointer(g_shader_program.get_tex_coordinate_attribute(), 2, GL_FLOAT,
-                          false, 0, texture_coordinates);
+void start_render_thread()
+{
+    // The context can only be current on one thread at a time
+    SDL_GL_MakeCurrent(g_display_window, nullptr);
 
-        draw_object(player_one->get_model_matrix(), player_one->get_texture_id());
-        draw_object(player_two->get_model_matrix(), player_two->get_texture_id());
+    g_render_thread_running.store(true, std::memory_order_release);
+    g_render_thread = std::thread(render_thread_main);
+}
+
+void stop_render_thread()
+{
+    g_render_thread_running.store(false, std::memory_order_release);
+    g_render_thread.join();
+}
+
+void render()
+{
+    // Replays can be timed without drawing (--skip-render)
+    if (g_skip_render)
+    {
+        g_frame_count++;
+        if (g_frame_limit > 0 && g_frame_count >= g_frame_limit) g_app_status = TERMINATED;
+        return;
+    }
+
+    if (g_use_render_thread)
+    {
+        TRACE_ZONE("build_render_list");
+        ALLOCATION_PHASE(PHASE_RENDER);
+        build_render_list(g_render_lists.back());
+        g_render_lists.publish();
+
+        g_frame_count++;
+        if (g_frame_limit > 0 && g_frame_count >= g_frame_limit) g_app_status = TERMINATED;
+        return;
+    }
+
+    {
+        ScopedCpuTimer timer(g_profiler, PHASE_RENDER);
+        TRACE_ZONE("render");
+        ALLOCATION_PHASE(PHASE_RENDER);
 
-        for (int i = 0; i < Ball::MAX_AMOUNT; i++)
         {
-            if (balls[i].get_status()) 
-            {
-                draw_object(balls[i].get_model_matrix(), 
-                            balls[i].get_owner() ? g_ball_one_texture_id
-                                                 : g_ball_two_texture_id
-                );
-            }
+            TRACE_ZONE("build_render_list");
+            build_render_list(g_render_list);
         }
 
-        draw_object(TOP_WALL_MODEL_MATRIX, g_wall_texture_id);
-        draw_object(LOW_WALL_MODEL_MATRIX, g_wall_texture_id);
+        if (g_software_renderer != nullptr) render_software(g_render_list);
+        else                                render_gl(g_render_list);
     }
+    g_latency.frame_drawn(g_render_list.get_input_sequence());
 
-    // We disable two attribute arrays now
-    glDisableVertexAttribArray(g_shader_program.get_position_attribute());
-    glDisableVertexAttribArray(g_shader_program.get_tex_coordinate_attribute());
+    if (g_software_renderer == nullptr) present();
+    g_profiler.frame_presented();
+    g_latency.frame_presented();
 
-    SDL_GL_SwapWindow(g_display_window);
+    g_frame_count++;
+    if (g_frame_limit > 0 && g_frame_count >= g_frame_limit) g_app_status = TERMINATED;
+}
+
+// Reports startup once the first frame is out; tracing stops there
+void finish_startup_trace()
+{
+    g_startup_tracer->record("first_frame", nullptr, 0.0, g_startup_tracer->now());
+    g_startup_tracer->write_summary(stdout);
+
+    if (!g_startup_tracer->write_trace(g_startup_trace_path)) LOG("Unable to write startup trace " << g_startup_trace_path);
+
+    g_startup_tracer->stop();
+}
+
+void write_histograms()
+{
+    if (!g_profiler.write_histograms(g_histogram_path)) LOG("Unable to write histograms " << g_histogram_path);
+    g_last_histogram_write = SDL_GetTicks();
 }
 
 void shutdown()
 { 
+    if (g_use_render_thread) stop_render_thread();
+
+    if (g_trace_path != nullptr && !TraceRecorder::get().stop()) LOG("Unable to write trace " << g_trace_path);
+
+    if (g_allocation_report_path != nullptr && !AllocationTracker::get().write(g_allocation_report_path))
+    {
+        LOG("Unable to write allocation report " << g_allocation_report_path);
+    }
+
+    if (g_histogram_path != nullptr) write_histograms();
+
+    if (g_print_digest) LOG("Match digest: " << std::hex << g_match_hash << std::dec);
+
+    if (g_latency_path != nullptr && !g_latency.write(g_latency_path)) LOG("Unable to write latency report " << g_latency_path);
+
+    if (g_record_path != nullptr && !g_replay.save(g_record_path)) LOG("Unable to write replay " << g_record_path);
+
+    if (g_profile_path != nullptr && !g_profiler.write(g_profile_path))
+    {
+        LOG("Unable to write profile " << g_profile_path);
+    }
+    if (g_profile_path != nullptr)
+    {
+        LOG("Resident texture memory: " << g_textures.get_resident_bytes() / BYTES_IN_KILOBYTE << " KiB");
+    }
+
     delete player_one;
     delete player_two;
 
     delete [] balls;
+    delete g_chaos_balls;
+    delete g_arenas;
+    delete g_particles;
+
+    // Everything still referenced: the whole set during a match, only the winner's screen after it
+    if (g_won)
+    {
+        g_textures.release(g_shown_win_texture);
+    }
+    else
+    {
+        hold_match_textures(false);
+        g_textures.release(g_win_one_texture);
+        g_textures.release(g_win_two_texture);
+    }
+
+    // Prefetch threads may still be decoding with the bundle and tracer
+    g_textures.stop_prefetching();
+    delete g_startup_tracer;
+
+    delete g_software_renderer;
+    delete g_static_layer;
+
+    if (g_frame_readback != nullptr)
+    {
+        g_frame_readback->flush();
+        delete g_frame_readback;
+    }
 
     SDL_Quit(); 
 }
 
+void run_game_loop()
+{
+    while (g_app_status == RUNNING)
+    {
+        Uint32 tick_start = SDL_GetTicks();
+
+        {
+            ScopedCpuTimer timer(g_profiler, PHASE_INPUT);
+            TRACE_ZONE("process_input");
+            ALLOCATION_PHASE(PHASE_INPUT);
+            process_input();
+        }
+        {
+            ScopedCpuTimer timer(g_profiler, PHASE_UPDATE);
+            TRACE_ZONE("update");
+            ALLOCATION_PHASE(PHASE_UPDATE);
+            update();
+        }
+        render();
+
+        if (g_startup_tracer != nullptr && !g_startup_tracer->is_stopped()) finish_startup_trace();
+
+        if (g_histogram_path != nullptr &&
+            SDL_GetTicks() - g_last_histogram_write >= HISTOGRAM_WRITE_INTERVAL_MILLISECONDS)
+        {
+            write_histograms();
+        }
+
+        // Headless runs have no frame rate to protect but can outrun the rings
+        if (g_trace_path != nullptr &&
+            (g_headless || SDL_GetTicks() - g_last_trace_drain >= TRACE_DRAIN_INTERVAL_MILLISECONDS))
+        {
+            TraceRecorder::get().drain();
+            g_last_trace_drain = SDL_GetTicks();
+        }
+
+        AllocationTracker::get().frame_finished();
+
+        if (g_use_render_thread)
+        {
+            Uint32 elapsed = SDL_GetTicks() - tick_start;
+            if (elapsed < SIMULATION_TICK_MILLISECONDS) SDL_Delay(SIMULATION_TICK_MILLISECONDS - elapsed);
+        }
+    }
+}
+
+void game_thread_main()
+{
+    if (!g_use_render_thread) SDL_GL_MakeCurrent(g_display_window, g_gl_context);
+    TRACE_THREAD_NAME("game");
+
+    run_game_loop();
+
+    if (!g_use_render_thread) SDL_GL_MakeCurrent(g_display_window, nullptr);
+}
+
+// Takes whatever events SDL has, queues the key events for the game thread and publishes the held movement keys
+void sample_input()
+{
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        switch (event.type)
+        {
+            case SDL_QUIT:
+            case SDL_WINDOWEVENT_CLOSE:
+                g_app_status = TERMINATED;
+                break;
+            case SDL_KEYUP:
+            case SDL_KEYDOWN:
+                // A full ring only loses the moment a key changed, not the change itself
+                g_input_sampler.push({ event.key.timestamp, event.key.keysym.scancode, event.key.keysym.sym,
+                                       event.type == SDL_KEYDOWN });
+                break;
+            default:
+                break;
+        }
+    }
+
+    const Uint8 *key_state = SDL_GetKeyboardState(NULL);
+    uint32_t held_keys = 0;
+    for (int key = 0; key < MOVEMENT_KEY_COUNT; key++)
+    {
+        if (key_state[MOVEMENT_KEYS[key]]) held_keys |= 1u << key;
+    }
+    g_input_sampler.publish(held_keys);
+}
+
+// Samples input on the main thread at a steady rate until the game ends
+void run_input_sampling()
+{
+    std::chrono::steady_clock::time_point next_sample = std::chrono::steady_clock::now();
+    while (g_app_status == RUNNING)
+    {
+        sample_input();
+
+        // After a stall, carry on from now rather than catching up
+        next_sample = std::max(next_sample + INPUT_SAMPLE_INTERVAL, std::chrono::steady_clock::now());
+        std::this_thread::sleep_until(next_sample);
+    }
+}
+
 int main(int argc, char* argv[])
 {
+    // Headless options:
+    // --software     render on the CPU instead of through an OpenGL window
+    // --offscreen    render through OpenGL without a visible window (EGL when
+    //                built with PONG_USE_EGL) and read frames back asynchronously
+    // --frames N     stop after N frames
+    // --output DIR   write every frame to DIR/frame_NNNNN.ppm
+    //
+    // --render-thread  draw on a separate thread so the simulation never waits
+    //                  on SDL_GL_SwapWindow (windowed OpenGL only, and not on
+    //                  macOS, where Cocoa wants the drawing and swaps on the
+    //                  main thread)
+    // --input-thread   sample the keyboard at 1 kHz on the main thread and run
+    //                  the game loop, drawing included, on another, so slow
+    //                  frames do not delay input (windowed only, and not on
+    //                  macOS, where Cocoa wants the drawing and swaps on the
+    //                  main thread)
+    // --profile FILE   write per-phase CPU and GPU frame timings to FILE on exit
+    // --histogram FILE  write frame and phase time percentiles to FILE every
+    //                   few seconds and on exit
+    // --texture-budget KB  evict textures that are not on screen once they
+    //                       take up more than KB kilobytes
+    // --startup-trace FILE  time each startup phase and asset, print a summary
+    //                       once the first frame is out and write a Chrome
+    //                       trace of it to FILE
+    // --trace FILE  write a Chrome trace of every frame's phases, ball hits
+    //               and scores to FILE (builds with PONG_TRACE only)
+    // --record FILE  save this session's input to FILE on exit
+    // --replay FILE  play back a recorded session instead of reading the
+    //                keyboard, then exit; pair with --software and --profile
+    //                to time it
+    // --skip-render  run input and update only, drawing nothing
+    // --allocations FILE  count heap allocations per frame and phase and
+    //                     write them, with their call stacks, to FILE on
+    //                     exit (builds with PONG_TRACK_ALLOCATIONS only)
+    // --require-no-allocations  exit with status 1 if any frame allocated
+    //                           once warmed up; pair with --replay and
+    //                           --software (builds with
+    //                           PONG_TRACK_ALLOCATIONS only, refused
+    //                           otherwise)
+    // --chaos N  chaos mode: up to N balls at once, split on every paddle hit
+    //            and scored one by one; keys 1, 2 and 3 serve 1, 100 and
+    //            10000 more
+    // --arenas N  spectator view: N CPU-against-CPU matches played at once
+    //             and drawn as a grid; keys 1, 2 and 3 set every arena's
+    //             ball count
+    // --policy POLICY  player two, in every arena too, is played by POLICY:
+    //                  a built-in one from PaddlePolicy.h or the path of a
+    //                  plugin (see pong_policy.h); replays need the same one
+    // --digest  print a hash of the whole match on exit; the same replay
+    //           gives the same digest on any build that plays identically,
+    //           such as with and without PONG_GLM_SIMD
+    // --latency FILE  follow every paddle input from its key event through
+    //                 polling, update, drawing and the swap, and write each
+    //                 stage's latency percentiles to FILE on exit
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp(argv[i], "--software") == 0)               g_software_renderer = new SoftwareRenderer(WINDOW_WIDTH, WINDOW_HEIGHT);
+        else if (strcmp(argv[i], "--offscreen") == 0)              g_offscreen = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) g_frame_limit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) g_frame_output_dir = argv[++i];
+        else if (strcmp(argv[i], "--render-thread") == 0)          g_use_render_thread = true;
+        else if (strcmp(argv[i], "--input-thread") == 0)           g_use_input_thread = true;
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) g_profile_path = argv[++i];
+        else if (strcmp(argv[i], "--histogram") == 0 && i + 1 < argc) g_histogram_path = argv[++i];
+        else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+        {
+            g_textures.set_budget((size_t) atoi(argv[++i]) * BYTES_IN_KILOBYTE);
+        }
+        else if (strcmp(argv[i], "--startup-trace") == 0 && i + 1 < argc)
+        {
+            g_startup_trace_path = argv[++i];
+            g_startup_tracer = new StartupTracer();
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) g_trace_path = argv[++i];
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) g_record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) g_replay_path = argv[++i];
+        else if (strcmp(argv[i], "--skip-render") == 0)            g_skip_render = true;
+        else if (strcmp(argv[i], "--allocations") == 0 && i + 1 < argc) g_allocation_report_path = argv[++i];
+        else if (strcmp(argv[i], "--require-no-allocations") == 0) g_require_no_allocations = true;
+        else if (strcmp(argv[i], "--chaos") == 0 && i + 1 < argc)  g_chaos_capacity = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--arenas") == 0 && i + 1 < argc) g_arena_count = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) g_policy_argument = argv[++i];
+        else if (strcmp(argv[i], "--digest") == 0)                 g_print_digest = true;
+        else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) g_latency_path = argv[++i];
+    }
+
+    if (g_replay_path != nullptr)
+    {
+        if (!g_replay.load(g_replay_path) || g_replay.size() == 0)
+        {
+            LOG("Unable to load replay " << g_replay_path);
+            return 1;
+        }
+        g_record_path = nullptr; // the replay is already a recording
+    }
+
+#ifndef PONG_TRACK_ALLOCATIONS
+    // Nothing would be counted, so the check would pass whatever the game did
+    if (g_require_no_allocations)
+    {
+        LOG("--require-no-allocations needs a build with PONG_TRACK_ALLOCATIONS");
+        return 1;
+    }
+#endif
+
+    if (g_policy_argument != nullptr)
+    {
+        g_player_two_policy = find_or_load_policy(g_policy_argument, g_policy_plugin);
+        if (g_player_two_policy == nullptr)
+        {
+            LOG("Unable to load policy " << g_policy_argument << ' ' << g_policy_plugin.get_error());
+            return 1;
+        }
+    }
+
+    if (g_trace_path != nullptr)
+    {
+#ifndef PONG_TRACE
+        LOG("Built without PONG_TRACE, so the trace will be empty");
+#endif
+        if (!TraceRecorder::get().start(g_trace_path))
+        {
+            LOG("Unable to create trace " << g_trace_path);
+            g_trace_path = nullptr;
+        }
+    }
+    TRACE_THREAD_NAME("main");
+
+    g_latency.set_enabled(g_latency_path != nullptr);
+
+    g_headless = g_software_renderer != nullptr || g_offscreen;
+    g_use_render_thread = g_use_render_thread && !g_headless;
+    g_use_input_thread = g_use_input_thread && !g_headless;
+
+#ifdef __APPLE__
+    // Cocoa wants the context and swaps on the main thread, which the render
+    // thread would take them from
+    if (g_use_render_thread)
+    {
+        LOG("--render-thread is not supported on macOS; frames are drawn on the main thread instead");
+        g_use_render_thread = false;
+    }
+
+    // Events have to be pumped on the main thread, and the context and swaps
+    // should stay there too, so there is no thread left to hand the game to
+    if (g_use_input_thread)
+    {
+        LOG("--input-thread is not supported on macOS; input is read once per frame instead");
+        g_use_input_thread = false;
+    }
+#endif
+
     initialise();
 
-    while (g_app_status == RUNNING)
+    if (g_use_render_thread) start_render_thread();
+
+    if (g_allocation_report_path != nullptr || g_require_no_allocations)
     {
-        process_input();
-        update();
-        render();
+#ifndef PONG_TRACK_ALLOCATIONS
+        LOG("Built without PONG_TRACK_ALLOCATIONS, so no allocations will be counted");
+#endif
+        AllocationTracker::get().start();
+    }
+
+    if (g_use_input_thread)
+    {
+        // The game thread takes the context over unless the render thread already has
+        if (!g_use_render_thread) SDL_GL_MakeCurrent(g_display_window, nullptr);
+
+        std::thread game_thread(game_thread_main);
+        run_input_sampling();
+        game_thread.join();
+
+        if (!g_use_render_thread) SDL_GL_MakeCurrent(g_display_window, g_gl_context);
     }
+    else run_game_loop();
 
+    uint64_t steady_frames_allocating = AllocationTracker::get().get_steady_frames_allocating();
     shutdown();
+
+    if (g_require_no_allocations && steady_frames_allocating > 0)
+    {
+        LOG(steady_frames_allocating << " frames allocated after the warm-up");
+        return 1;
+    }
     return 0;
 }
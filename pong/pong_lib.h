@@ -2,8 +2,12 @@
 
 #include <time.h>
 #include <stdlib.h>
+#include <random>
 
-constexpr glm::mat4 IDENTITY_MATRIX = glm::mat4(1.0f);
+#include "MathConfig.h"
+
+MATH_CONSTANT glm::mat4 IDENTITY_MATRIX = glm::mat4(1.0f);
+MATH_CONSTANT glm::vec4 IDENTITY_TRANSFORM = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
 
 constexpr float SPEED = 3.0f;
 
@@ -12,15 +16,23 @@ constexpr float STANDARD_HEIGHT = 0.78f;
 
 constexpr int FIRST_TO_SCORE = 3;
 
+/**
+ * Where serve angles come from: rand(), which the game seeds and replays
+ * depend on, unless the calling thread points this at a generator of its
+ * own. Threads playing matches side by side, like the tournament tool's,
+ * each do, so no match shares random state with another.
+ */
+inline thread_local std::mt19937 *g_serve_random = nullptr;
+
 class Paddle
 {
     public:
-        static constexpr glm::vec3 INIT_SCALE = glm::vec3(0.64, 1.28f, 0.0f);
-        static constexpr glm::vec3 INIT_POS = glm::vec3(3.08f, 0.0f, 0.0f);
+        static MATH_CONSTANT glm::vec3 INIT_SCALE = glm::vec3(0.64, 1.28f, 0.0f);
+        static MATH_CONSTANT glm::vec3 INIT_POS = glm::vec3(3.08f, 0.0f, 0.0f);
         static constexpr float VERTICAL_BOUND = 1.712f;
 
     private:
-        glm::mat4 model_matrix;
+        glm::vec4 transform;
         glm::vec3 position;
         float direction;
         int score;
@@ -32,7 +44,7 @@ class Paddle
         {
             this->position = position;
             this->direction = 0.0f;
-            this->model_matrix = glm::mat4(1.0f);
+            this->transform = IDENTITY_TRANSFORM;
             this->texture_id = texture_id;
             this->score = 0;
             this->is_player = true;
@@ -48,9 +60,9 @@ class Paddle
             return this->position;
         }
 
-        glm::mat4 get_model_matrix()
+        const glm::vec4& get_transform() const
         {
-            return this->model_matrix;
+            return this->transform;
         }
 
         int get_score()
@@ -58,15 +70,10 @@ class Paddle
             return this->score;
         }
 
-        void update_model_matrix()
+        // Offset in xy and scale in zw, which is all a 2D sprite needs
+        void update_transform()
         {
-            this->model_matrix = glm::scale(
-                glm::translate(
-                    IDENTITY_MATRIX,
-                    this->position
-                ),
-                INIT_SCALE
-            );
+            this->transform = glm::vec4(this->position.x, this->position.y, INIT_SCALE.x, INIT_SCALE.y);
         }
 
         void set_neutral()
@@ -149,57 +156,72 @@ class Paddle
 class Ball
 {
     public:
-        static constexpr glm::vec3 INIT_SCALE = glm::vec3(0.32f, 0.32f, 0.0f);
+        static MATH_CONSTANT glm::vec3 INIT_SCALE = glm::vec3(0.32f, 0.32f, 0.0f);
         static constexpr float VERTICAL_BOUND = 2.2f;
         static constexpr float HORIZONTAL_BOUND = 4.17f;
         static constexpr int MAX_AMOUNT = 3;
 
     private:
-        glm::mat4 model_matrix;
-        glm::vec3 position;
-        glm::vec3 direction;
+        glm::vec4 transform;
+        glm::vec4 position,  // z and w stay zero; as vec4s a step is one vector
+                  direction; // multiply-add where glm has SIMD paths
         int bounces;
         bool is_player_one;
         bool is_enabled;
+        bool hit_wall;
 
         static float get_rand_radian()
         {
-            float normalized = ((float) rand()) / ((float) RAND_MAX);
+            float normalized = g_serve_random != nullptr
+                             ? (float) ((double) (*g_serve_random)() / (double) std::mt19937::max())
+                             : ((float) rand()) / ((float) RAND_MAX);
             return 2.0f * M_PI * normalized - M_PI / 2.0f;
         }
 
     public:
         Ball()
         {
-            this->model_matrix = IDENTITY_MATRIX;
-            this->position = glm::vec3(0.0f, 0.0f, 0.0f);
-            this->direction = glm::vec3(0.0f, 0.0f, 0.0f);
+            this->transform = IDENTITY_TRANSFORM;
+            this->position = glm::vec4(0.0f);
+            this->direction = glm::vec4(0.0f);
             this->bounces = 0;
             this->is_player_one = true;
             this->is_enabled = false;
+            this->hit_wall = false;
 
             this->set_random_direction();
         }
 
         glm::vec3 get_position()
         {
-            return this->position;
+            return glm::vec3(this->position);
+        }
+
+        void set_position(glm::vec3 position)
+        {
+            this->position = glm::vec4(position, 0.0f);
+        }
+
+        glm::vec3 get_direction()
+        {
+            return glm::vec3(this->direction);
+        }
+
+        // Expected to be of unit length
+        void set_direction(glm::vec3 direction)
+        {
+            this->direction = glm::vec4(direction, 0.0f);
         }
 
-        glm::mat4 get_model_matrix()
+        const glm::vec4& get_transform() const
         {
-            return this->model_matrix;
+            return this->transform;
         }
 
-        void update_model_matrix()
+        // Offset in xy and scale in zw, which is all a 2D sprite needs
+        void update_transform()
         {
-            this->model_matrix = glm::scale(
-                glm::translate(
-                    IDENTITY_MATRIX,
-                    this->position
-                ),
-                INIT_SCALE
-            );
+            this->transform = glm::vec4(this->position.x, this->position.y, INIT_SCALE.x, INIT_SCALE.y);
         }
 
         void enable()
@@ -222,6 +244,18 @@ class Ball
             return this->is_player_one;
         }
 
+        // Paddle and wall hits since the ball was last served
+        int get_bounces() const
+        {
+            return this->bounces;
+        }
+
+        // Whether the last update bounced off the top or bottom wall
+        bool get_wall_hit()
+        {
+            return this->hit_wall;
+        }
+
         void set_player_one()
         {
             this->is_player_one = true;
@@ -262,7 +296,7 @@ class Ball
 
         void reset()
         {
-            this->position = glm::vec3(0.0f, 0.0f, 0.0f);
+            this->position = glm::vec4(0.0f);
             this->bounces = 0;
             this->set_random_direction();
         }
@@ -271,7 +305,7 @@ class Ball
         {
             float total_speed = SPEED + 0.1f * bounces;
             glm::vec3 p_pos = p->get_position();
-            glm::vec3 b_pos = this->position + this->direction * total_speed * delta_time;
+            glm::vec4 b_pos = this->position + this->direction * total_speed * delta_time;
 
             bool old_col_x = (this->position.x <= p_pos.x + STANDARD_WIDTH) && 
                              (this->position.x + STANDARD_WIDTH  >= p_pos.x);
@@ -284,6 +318,7 @@ class Ball
                              (b_pos.y >= p_pos.y - STANDARD_HEIGHT);
 
             bool hit_paddle = false;
+            this->hit_wall = false;
 
             if (new_col_x && new_col_y)
             {
@@ -298,6 +333,7 @@ class Ball
             {
                 this->direction.y *= -1.0f;
                 this->bounces++;
+                this->hit_wall = true;
             } 
 
             this->position += this->direction * total_speed * delta_time;
@@ -312,3 +348,16 @@ class Ball
                                               << "\n\tBounces: " << b.bounces;
         }
 };
+
+/**
+ * Rebuilds the transforms of every entity in one pass. Balls are handled
+ * without branching on whether they are enabled, so the loop stays a
+ * straight run of independent vector stores the compiler can vectorise.
+ */
+inline void update_transforms(Paddle *player_one, Paddle *player_two, Ball *balls, int ball_count)
+{
+    player_one->update_transform();
+    player_two->update_transform();
+
+    for (int i = 0; i < ball_count; i++) balls[i].update_transform();
+}
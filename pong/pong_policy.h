@@ -0,0 +1,74 @@
+#pragma once
+
+/**
+ * The C ABI between the game and paddle policy plugins: shared libraries
+ * loaded at runtime (see PolicyPlugin.h) that move paddles, so bots can be
+ * changed without rebuilding the game or its tools.
+ *
+ * A plugin includes this header, from C or C++, and exports the three
+ * functions declared at the bottom. Build one with, for example:
+ *
+ *     cc -std=c99 -O2 -shared -fPIC -I pong tools/example_policy.c -o example_policy.so
+ *
+ * Decisions are batched: one call decides every paddle a policy plays that
+ * tick, across all the matches being run, so the cost of calling into the
+ * plugin is paid once per tick rather than once per paddle. The call may
+ * come from several threads at once, each with a batch of its own, and the
+ * same observations must always get the same directions, or tournaments
+ * stop being reproducible.
+ */
+
+#include <stdint.h>
+
+#define PONG_POLICY_ABI_VERSION 1
+#define PONG_POLICY_MAX_BALLS   3
+
+/* A ball as a paddle policy sees it */
+typedef struct ObservedBall
+{
+    float x, y,
+          direction_x, direction_y; /* of unit length */
+} ObservedBall;
+
+/* Everything a paddle policy gets to decide on, once per tick */
+typedef struct PaddleObservation
+{
+    float paddle_x, paddle_y,
+          opponent_y;
+    int32_t side;       /* -1 on the left, 1 on the right */
+    int32_t score,
+            opponent_score;
+    uint32_t tick;      /* since the match started */
+    int32_t ball_count; /* of the balls in play, the first ball_count entries */
+    /* At most PONG_POLICY_MAX_BALLS of the balls in play. With more in play,
+       as in chaos mode, the ones coming at the paddle that will reach it
+       soonest come first, then the nearest of the rest; the others are
+       left out. */
+    ObservedBall balls[PONG_POLICY_MAX_BALLS];
+} PaddleObservation;
+
+#if defined(_WIN32)
+#define PONG_POLICY_VISIBLE __declspec(dllexport)
+#else
+#define PONG_POLICY_VISIBLE __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+#define PONG_POLICY_EXPORT extern "C" PONG_POLICY_VISIBLE
+#else
+#define PONG_POLICY_EXPORT PONG_POLICY_VISIBLE
+#endif
+
+/* What a plugin exports, under these names */
+typedef uint32_t    (*PongPolicyAbiVersion)(void);
+typedef const char* (*PongPolicyName)(void);
+typedef void        (*PongPolicyDecide)(const PaddleObservation *observations, int32_t count, int32_t *directions);
+
+/* Must return PONG_POLICY_ABI_VERSION, or the plugin is not loaded */
+PONG_POLICY_EXPORT uint32_t pong_policy_abi_version(void);
+
+/* What to call the policy in results; the string has to outlive the plugin's use */
+PONG_POLICY_EXPORT const char* pong_policy_name(void);
+
+/* Sets directions[i], 1 up, -1 down or 0 neither, for each of count observations */
+PONG_POLICY_EXPORT void pong_policy_decide(const PaddleObservation *observations, int32_t count, int32_t *directions);
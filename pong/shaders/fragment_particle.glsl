@@ -0,0 +1,7 @@
+
+uniform vec4 color;
+varying float alphaVar;
+
+void main() {
+    gl_FragColor = vec4(color.rgb, color.a * alphaVar);
+}
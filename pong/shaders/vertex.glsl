@@ -1,11 +1,11 @@
-attribute vec4 position;
+attribute vec2 position;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+// Offset in xy, scale in zw
+uniform vec4 modelTransform;
+uniform mat4 viewProjectionMatrix;
 
 void main()
 {
-	vec4 p = viewMatrix * modelMatrix  * position;
-	gl_Position = projectionMatrix * p;
+	vec2 p = position * modelTransform.zw + modelTransform.xy;
+	gl_Position = viewProjectionMatrix * vec4(p, 0.0, 1.0);
 }
@@ -0,0 +1,18 @@
+attribute vec2 position;
+
+// x, y, size and alpha of one particle
+attribute vec4 instance;
+
+// Width and height of an instance, in multiples of its size
+uniform vec2 shape;
+
+uniform mat4 viewProjectionMatrix;
+
+varying float alphaVar;
+
+void main()
+{
+	vec2 p = position * shape * instance.z + instance.xy;
+    alphaVar = instance.w;
+	gl_Position = viewProjectionMatrix * vec4(p, 0.0, 1.0);
+}
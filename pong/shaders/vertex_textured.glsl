@@ -1,15 +1,15 @@
-attribute vec4 position;
+attribute vec2 position;
 attribute vec2 texCoord;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+// Offset in xy, scale in zw
+uniform vec4 modelTransform;
+uniform mat4 viewProjectionMatrix;
 
 varying vec2 texCoordVar;
 
 void main()
 {
-	vec4 p = viewMatrix * modelMatrix  * position;
+	vec2 p = position * modelTransform.zw + modelTransform.xy;
     texCoordVar = texCoord;
-	gl_Position = projectionMatrix * p;
+	gl_Position = viewProjectionMatrix * vec4(p, 0.0, 1.0);
 }
\ No newline at end of file
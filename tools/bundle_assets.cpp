@@ -0,0 +1,132 @@
+/**
+ * Packs the game's assets into one pre-decoded bundle (see AssetBundle.h).
+ * PNGs are decoded to RGBA8 here, once, instead of on every launch; every
+ * other file is stored verbatim as shader source.
+ *
+ * Build from the repository root, then run the bundler from pong/ so entries
+ * are named by the same relative paths the game loads them by, passing it
+ * every PNG in content/ and every shader in shaders/:
+ *
+ *     c++ -std=c++17 -O2 -I pong tools/bundle_assets.cpp -o bundle_assets
+ *     cd pong && ../bundle_assets content/assets.pak $(find content shaders -name '*.png' -o -name '*.glsl')
+ *
+ * The bundle has to be rebuilt whenever one of its assets changes; the game
+ * loads anything missing from it from the original files.
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "AssetBundle.h"
+
+static bool ends_with(const char *text, const char *suffix)
+{
+    size_t text_length = std::strlen(text),
+           suffix_length = std::strlen(suffix);
+    return text_length >= suffix_length && std::strcmp(text + text_length - suffix_length, suffix) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s OUTPUT FILE...\n", argv[0]);
+        return 2;
+    }
+
+    const char *output_filepath = argv[1];
+    int entry_count = argc - 2;
+
+    std::vector<AssetEntry> entries(entry_count);
+    std::vector<std::vector<uint8_t>> blobs(entry_count);
+
+    uint64_t offset = sizeof(AssetBundleHeader) + entry_count * sizeof(AssetEntry);
+
+    for (int i = 0; i < entry_count; i++)
+    {
+        const char *filepath = argv[i + 2];
+        AssetEntry &entry = entries[i];
+        std::memset(&entry, 0, sizeof(entry));
+
+        if (std::strlen(filepath) >= ASSET_NAME_LENGTH)
+        {
+            std::fprintf(stderr, "Error: %s is too long a path for a bundle entry.\n", filepath);
+            return 1;
+        }
+        std::strcpy(entry.name, filepath);
+
+        if (ends_with(filepath, ".png"))
+        {
+            int width, height, number_of_components;
+            unsigned char *image = stbi_load(filepath, &width, &height, &number_of_components, STBI_rgb_alpha);
+            if (image == nullptr)
+            {
+                std::fprintf(stderr, "Error: unable to decode %s: %s\n", filepath, stbi_failure_reason());
+                return 1;
+            }
+
+            entry.type = ASSET_TEXTURE_RGBA8;
+            entry.width = width;
+            entry.height = height;
+            blobs[i].assign(image, image + (size_t) width * height * 4);
+            stbi_image_free(image);
+        }
+        else
+        {
+            std::ifstream file(filepath, std::ios::binary);
+            if (!file)
+            {
+                std::fprintf(stderr, "Error: unable to open %s\n", filepath);
+                return 1;
+            }
+
+            entry.type = ASSET_SHADER_SOURCE;
+            blobs[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        offset = (offset + ASSET_BLOB_ALIGNMENT - 1) & ~(ASSET_BLOB_ALIGNMENT - 1);
+        entry.offset = offset;
+        entry.size = blobs[i].size();
+        offset += entry.size;
+    }
+
+    FILE *output = std::fopen(output_filepath, "wb");
+    if (output == nullptr)
+    {
+        std::fprintf(stderr, "Error: unable to create %s\n", output_filepath);
+        return 1;
+    }
+
+    AssetBundleHeader header;
+    std::memcpy(header.magic, ASSET_BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = ASSET_BUNDLE_VERSION;
+    header.entry_count = entry_count;
+
+    std::fwrite(&header, sizeof(header), 1, output);
+    std::fwrite(entries.data(), sizeof(AssetEntry), entry_count, output);
+
+    // Pad up to each blob's aligned offset
+    const uint8_t padding[ASSET_BLOB_ALIGNMENT] = {};
+    uint64_t written = sizeof(AssetBundleHeader) + entry_count * sizeof(AssetEntry);
+    for (int i = 0; i < entry_count; i++)
+    {
+        std::fwrite(padding, 1, entries[i].offset - written, output);
+        std::fwrite(blobs[i].data(), 1, blobs[i].size(), output);
+        written = entries[i].offset + entries[i].size;
+    }
+
+    if (std::fclose(output) != 0)
+    {
+        std::fprintf(stderr, "Error: unable to write %s\n", output_filepath);
+        return 1;
+    }
+
+    std::printf("%s: %d assets, %llu bytes\n", output_filepath, entry_count, (unsigned long long) written);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * Writes the given files out as C++ byte arrays, for EmbeddedAssets.h to
+ * compile into the executable. Every file is embedded verbatim: PNGs are
+ * decoded with stbi_load_from_memory at runtime and shaders are compiled
+ * straight from the embedded text.
+ *
+ * Build from the repository root, then run from pong/ so assets are named
+ * by the same relative paths the game loads them by:
+ *
+ *     c++ -std=c++17 -O2 tools/embed_assets.cpp -o embed_assets
+ *     cd pong && ../embed_assets embedded_assets.inc $(find content shaders -name '*.png' -o -name '*.glsl')
+ *
+ * The output has to be regenerated whenever one of the assets changes.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// Matches the bundle's blob alignment, so either source can be uploaded the same way
+constexpr int EMBEDDED_ALIGNMENT = 64;
+constexpr int BYTES_PER_LINE = 16;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s OUTPUT FILE...\n", argv[0]);
+        return 2;
+    }
+
+    FILE *output = std::fopen(argv[1], "w");
+    if (output == nullptr)
+    {
+        std::fprintf(stderr, "Error: unable to create %s\n", argv[1]);
+        return 1;
+    }
+
+    std::fprintf(output, "// Generated by tools/embed_assets.cpp; do not edit.\n\n");
+
+    std::vector<size_t> sizes;
+    for (int i = 2; i < argc; i++)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file)
+        {
+            std::fprintf(stderr, "Error: unable to open %s\n", argv[i]);
+            std::fclose(output);
+            return 1;
+        }
+        std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // A trailing null lets shader sources double as C strings
+        std::fprintf(output, "// %s\nalignas(%d) static const unsigned char EMBEDDED_ASSET_%d[] =\n{",
+                     argv[i], EMBEDDED_ALIGNMENT, i - 2);
+        contents.push_back(0);
+        for (size_t j = 0; j < contents.size(); j++)
+        {
+            if (j % BYTES_PER_LINE == 0) std::fprintf(output, "\n   ");
+            std::fprintf(output, " 0x%02x,", contents[j]);
+        }
+        std::fprintf(output, "\n};\n\n");
+
+        sizes.push_back(contents.size() - 1);
+    }
+
+    std::fprintf(output, "static const EmbeddedAsset EMBEDDED_ASSETS[] =\n{\n");
+    for (int i = 2; i < argc; i++)
+    {
+        std::fprintf(output, "    { \"%s\", EMBEDDED_ASSET_%d, %zu },\n", argv[i], i - 2, sizes[i - 2]);
+    }
+    std::fprintf(output, "};\n");
+
+    if (std::fclose(output) != 0)
+    {
+        std::fprintf(stderr, "Error: unable to write %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
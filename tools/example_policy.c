@@ -0,0 +1,72 @@
+/**
+ * An example paddle policy plugin, written against pong_policy.h in plain
+ * C: it waits in the middle until a ball coming its way crosses the centre
+ * line, then heads for where that ball will reach it, walls included.
+ *
+ * Build from the repository root, then pass the library wherever a policy
+ * is named:
+ *
+ *     cc -std=c99 -O2 -shared -fPIC -I pong tools/example_policy.c -o example_policy.so -lm
+ *     ./tournament cpu predictive ./example_policy.so
+ */
+
+#include <math.h>
+
+#include "pong_policy.h"
+
+/* How close to its target the paddle has to be to stop, as the built-in policies */
+#define DEAD_ZONE      0.1f
+/* Of the ball, as Ball::VERTICAL_BOUND, and of the paddle, as STANDARD_WIDTH */
+#define VERTICAL_BOUND 2.2f
+#define PADDLE_REACH   0.472f
+
+static int32_t move_towards(const PaddleObservation *observation, float target_y)
+{
+    if (target_y > observation->paddle_y + DEAD_ZONE) return 1;
+    if (target_y < observation->paddle_y - DEAD_ZONE) return -1;
+    return 0;
+}
+
+static int32_t decide(const PaddleObservation *observation)
+{
+    float best_travel = 0.0f, target_y = 0.0f;
+    int found = 0;
+
+    for (int32_t i = 0; i < observation->ball_count; i++)
+    {
+        const ObservedBall *ball = &observation->balls[i];
+
+        /* Only balls on our half and coming our way */
+        if (ball->direction_x * observation->side <= 0.0f || ball->x * observation->side < 0.0f) continue;
+
+        float distance = fabsf(observation->paddle_x - ball->x) - PADDLE_REACH,
+              travel   = (distance > 0.0f ? distance : 0.0f) / fabsf(ball->direction_x);
+        if (found && travel >= best_travel) continue;
+
+        float period = 4.0f * VERTICAL_BOUND,
+              folded = fmodf(ball->y + ball->direction_y * travel + VERTICAL_BOUND, period);
+        if (folded < 0.0f)                  folded += period;
+        if (folded > 2.0f * VERTICAL_BOUND) folded = period - folded;
+
+        found       = 1;
+        best_travel = travel;
+        target_y    = folded - VERTICAL_BOUND;
+    }
+
+    return move_towards(observation, target_y);
+}
+
+PONG_POLICY_EXPORT uint32_t pong_policy_abi_version(void)
+{
+    return PONG_POLICY_ABI_VERSION;
+}
+
+PONG_POLICY_EXPORT const char* pong_policy_name(void)
+{
+    return "late_predictive";
+}
+
+PONG_POLICY_EXPORT void pong_policy_decide(const PaddleObservation *observations, int32_t count, int32_t *directions)
+{
+    for (int32_t i = 0; i < count; i++) directions[i] = decide(&observations[i]);
+}
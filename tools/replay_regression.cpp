@@ -0,0 +1,266 @@
+/**
+ * Replays every recorded session given to it through the game, headless,
+ * several times over, and compares the time per tick against a stored
+ * baseline. Replays take the same input, seed and time steps on every run,
+ * so differences come from the build rather than from how the game was
+ * played.
+ *
+ * Each run is a separate `pong --software --replay FILE --profile ...`, so
+ * it goes through the game's own process_input() and update(), and with
+ * --render through render() and the software renderer as well. Build the
+ * game and this tool, then run from pong/ so the game finds its assets:
+ *
+ *     c++ -std=c++17 -O2 tools/replay_regression.cpp -o replay_regression
+ *     cd pong && ../replay_regression --pong ./pong --baseline ../bench/replays/baseline.csv \
+ *                    $(find ../bench/replays -name '*.replay')
+ *
+ * Baselines only mean something on the machine they were written on, so
+ * none is checked in: the first run against a baseline file that does not
+ * exist yet writes it, and later runs on that machine compare against it.
+ *
+ * Options:
+ *     --pong PATH         the game executable (default ./pong)
+ *     --repeat N          runs per replay (default 5)
+ *     --render            draw every frame too, and time it
+ *     --threshold PERCENT how much slower than the baseline a mean may get
+ *                         before the run fails (default 10), as long as it
+ *                         is also more than NOISE_SIGMAS standard deviations
+ *                         slower, so noisy metrics do not fail at random
+ *     --baseline FILE     the baseline to compare against, written if missing
+ *     --write-baseline    write this run's results to the baseline instead,
+ *                         keeping whatever else it holds
+ *
+ * Prints one "scenario,metric,mean_us,stddev_us,baseline_us,change_percent,status"
+ * line per result and exits with status 1 if anything regressed. Update time
+ * is reported as "update", or as "rendered_update" with --render since
+ * drawing in between changes what the cache holds.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WINDOWS
+constexpr char NULL_DEVICE[] = "NUL";
+#else
+constexpr char NULL_DEVICE[] = "/dev/null";
+#endif
+
+constexpr char PROFILE_FILEPATH[] = "replay_regression_profile.txt";
+constexpr double MICROSECONDS_IN_MILLISECOND = 1000.0,
+                 NOISE_SIGMAS = 2.0;
+
+struct Result
+{
+    std::string scenario, metric;
+    double mean_us, stddev_us;
+};
+
+// The scenario a replay file stands for: its name without directories or extension
+std::string get_scenario_name(const char *filepath)
+{
+    std::string name = filepath;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) name = name.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    if (dot != std::string::npos) name = name.substr(0, dot);
+    return name;
+}
+
+// Reads the session mean of every phase from a profile written by FrameProfiler::write
+bool read_profile(const char *filepath, std::map<std::string, double> &session_means_ms)
+{
+    FILE *file = std::fopen(filepath, "r");
+    if (file == nullptr) return false;
+
+    char line[256], phase[32];
+    long long samples;
+    double last, mean, min, max, session_mean, session_max;
+
+    std::fgets(line, sizeof(line), file); // header
+    while (std::fgets(line, sizeof(line), file) != nullptr)
+    {
+        if (std::sscanf(line, "%31s %lld %lf %lf %lf %lf %lf %lf", phase, &samples, &last, &mean, &min, &max,
+                        &session_mean, &session_max) == 8)
+        {
+            session_means_ms[phase] = session_mean;
+        }
+    }
+
+    std::fclose(file);
+    return true;
+}
+
+bool read_baseline(const char *filepath, std::map<std::string, Result> &baseline)
+{
+    FILE *file = std::fopen(filepath, "r");
+    if (file == nullptr) return false;
+
+    char scenario[128], metric[32];
+    double mean_us, stddev_us;
+    while (std::fscanf(file, " %127[^,],%31[^,],%lf,%lf", scenario, metric, &mean_us, &stddev_us) == 4)
+    {
+        baseline[std::string(scenario) + "," + metric] = { scenario, metric, mean_us, stddev_us };
+    }
+
+    std::fclose(file);
+    return true;
+}
+
+// Replaces the baseline's entries for the given results, adding any it lacks
+bool write_baseline(const char *filepath, const std::vector<Result> &results)
+{
+    std::map<std::string, Result> baseline;
+    read_baseline(filepath, baseline);
+    for (const Result &result : results) baseline[result.scenario + "," + result.metric] = result;
+
+    FILE *file = std::fopen(filepath, "w");
+    if (file == nullptr) return false;
+
+    for (const auto &entry : baseline)
+    {
+        const Result &result = entry.second;
+        std::fprintf(file, "%s,%s,%.3f,%.3f\n", result.scenario.c_str(), result.metric.c_str(),
+                     result.mean_us, result.stddev_us);
+    }
+
+    return std::fclose(file) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *pong = "./pong",
+               *baseline_path = nullptr;
+    int repeat = 5;
+    bool render = false,
+         writing_baseline = false;
+    double threshold_percent = 10.0;
+    std::vector<const char*> replays;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp(argv[i], "--pong") == 0 && i + 1 < argc)      pong = argv[++i];
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)    repeat = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--render") == 0)                    render = true;
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold_percent = atof(argv[++i]);
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)  baseline_path = argv[++i];
+        else if (strcmp(argv[i], "--write-baseline") == 0)            writing_baseline = true;
+        else                                                          replays.push_back(argv[i]);
+    }
+
+    if (replays.empty() || (writing_baseline && baseline_path == nullptr))
+    {
+        std::fprintf(stderr, "usage: %s [--pong PATH] [--repeat N] [--render] [--threshold PERCENT] "
+                             "[--baseline FILE [--write-baseline]] REPLAY...\n", argv[0]);
+        return 2;
+    }
+
+    // A first run on this machine sets the baseline rather than failing
+    FILE *existing = baseline_path != nullptr ? std::fopen(baseline_path, "r") : nullptr;
+    if (existing != nullptr)
+    {
+        std::fclose(existing);
+    }
+    else if (baseline_path != nullptr && !writing_baseline)
+    {
+        std::fprintf(stderr, "No baseline at %s yet; writing this run's results to it\n", baseline_path);
+        writing_baseline = true;
+    }
+
+    // Profile phases to compare, and what to call them
+    std::vector<std::pair<const char*, const char*>> metrics = { { "update", render ? "rendered_update" : "update" } };
+    if (render) metrics.push_back({ "render", "render" });
+
+    std::vector<Result> results;
+    for (const char *replay : replays)
+    {
+        std::map<std::string, std::vector<double>> samples_us;
+        for (int run = 0; run < repeat; run++)
+        {
+            std::string command = std::string("\"") + pong + "\" --software --replay \"" + replay +
+                                  "\" --profile " + PROFILE_FILEPATH + (render ? "" : " --skip-render") +
+                                  " > " + NULL_DEVICE;
+
+            std::map<std::string, double> session_means_ms;
+            if (std::system(command.c_str()) != 0 || !read_profile(PROFILE_FILEPATH, session_means_ms))
+            {
+                std::fprintf(stderr, "Error: unable to replay %s with %s\n", replay, pong);
+                std::remove(PROFILE_FILEPATH);
+                return 1;
+            }
+
+            for (const auto &metric : metrics)
+            {
+                samples_us[metric.second].push_back(session_means_ms[metric.first] * MICROSECONDS_IN_MILLISECOND);
+            }
+        }
+
+        for (const auto &metric : metrics)
+        {
+            const std::vector<double> &samples = samples_us[metric.second];
+
+            double sum = 0.0;
+            for (double sample : samples) sum += sample;
+            double mean = sum / samples.size();
+
+            double squared_deviations = 0.0;
+            for (double sample : samples) squared_deviations += (sample - mean) * (sample - mean);
+            double stddev = samples.size() > 1 ? std::sqrt(squared_deviations / (samples.size() - 1)) : 0.0;
+
+            results.push_back({ get_scenario_name(replay), metric.second, mean, stddev });
+        }
+    }
+    std::remove(PROFILE_FILEPATH);
+
+    if (writing_baseline)
+    {
+        if (!write_baseline(baseline_path, results))
+        {
+            std::fprintf(stderr, "Error: unable to write %s\n", baseline_path);
+            return 1;
+        }
+    }
+
+    std::map<std::string, Result> baseline;
+    if (baseline_path != nullptr && !writing_baseline && !read_baseline(baseline_path, baseline))
+    {
+        std::fprintf(stderr, "Error: unable to read %s\n", baseline_path);
+        return 1;
+    }
+
+    bool regressed = false;
+    std::printf("scenario,metric,mean_us,stddev_us,baseline_us,change_percent,status\n");
+    for (const Result &result : results)
+    {
+        auto expected = baseline.find(result.scenario + "," + result.metric);
+        if (expected == baseline.end())
+        {
+            std::printf("%s,%s,%.3f,%.3f,,,%s\n", result.scenario.c_str(), result.metric.c_str(),
+                        result.mean_us, result.stddev_us, writing_baseline ? "baseline" : "new");
+            continue;
+        }
+
+        double change_us = result.mean_us - expected->second.mean_us,
+               change_percent = change_us / expected->second.mean_us * 100.0,
+               noise_us = NOISE_SIGMAS * std::max(result.stddev_us, expected->second.stddev_us);
+
+        const char *status = "ok";
+        if (change_percent > threshold_percent && change_us > noise_us)
+        {
+            status = "regressed";
+            regressed = true;
+        }
+        else if (change_percent < -threshold_percent && -change_us > noise_us) status = "improved";
+
+        std::printf("%s,%s,%.3f,%.3f,%.3f,%.1f,%s\n", result.scenario.c_str(), result.metric.c_str(),
+                    result.mean_us, result.stddev_us, expected->second.mean_us, change_percent, status);
+    }
+
+    return regressed ? 1 : 0;
+}
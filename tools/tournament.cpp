@@ -0,0 +1,408 @@
+/**
+ * Plays paddle policies against each other, round robin, to compare bots:
+ * every pairing plays --matches matches, swapping sides after each, on a
+ * pool of threads, and the results are summed into a table per pairing and
+ * a table of standings.
+ *
+ * Matches are headless and run the game's own paddle, ball and scoring
+ * code at a fixed 60 Hz step, first to FIRST_TO_SCORE or a draw after
+ * MAX_MATCH_TICKS. Each thread plays a batch of one pairing's matches in
+ * lockstep, so every tick it asks each policy to decide for all the
+ * paddles it plays in one call, which is what makes plugins cheap to call.
+ * Every match serves from a generator seeded from --seed and its place in
+ * the schedule, and results are kept in schedule order, so the same seed
+ * gives the same table however many threads play it, however it is
+ * batched and in whatever order the matches finish.
+ *
+ * Build and run from the repository root:
+ *
+ *     c++ -std=c++17 -O2 -pthread -I pong tools/tournament.cpp -o tournament
+ *     ./tournament --matches 1000 cpu tracker predictive sweeper ./example_policy.so
+ *
+ * Options:
+ *     --matches K  matches per pairing (default 100)
+ *     --seed S     seed of the whole tournament (default 3113)
+ *     --threads N  threads to play on (default one per core)
+ *     --balls N    balls in play at once, 1 to Ball::MAX_AMOUNT (default 1)
+ *     --batch N    matches each thread plays in lockstep (default 64)
+ *
+ * Policies are named as in PaddlePolicy.h's BUILT_IN_POLICIES, or given as
+ * the path of a plugin (see pong_policy.h); all the built-in ones play
+ * when none are given. Prints the two tables as CSV and how long they took
+ * to stderr. A rally is a point, from serve to score: its length in paddle
+ * hits and ticks, and the scoring ball's bounces off paddles and walls.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "MathConfig.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+using GLuint = unsigned int;
+
+#include "PaddlePolicy.h"
+#include "PolicyPlugin.h"
+#include "Simulation.h"
+
+constexpr float    DELTA_TIME      = 1.0f / 60.0f;
+constexpr uint32_t MAX_MATCH_TICKS = 60 * 60 * 5; // five minutes of play
+
+// How one match went, from the side of the policy listed first in its pairing
+struct MatchResult
+{
+    int points_for = 0,
+        points_against = 0;
+    int rallies = 0;
+    long long rally_hits = 0,
+              rally_ticks = 0,
+              bounces = 0;
+    int max_bounces = 0;
+};
+
+// A pairing's matches, or a policy's over the whole tournament
+struct Tally
+{
+    int matches = 0,
+        wins = 0,
+        losses = 0,
+        draws = 0,
+        points_for = 0,
+        points_against = 0;
+    int rallies = 0;
+    long long rally_hits = 0,
+              rally_ticks = 0,
+              bounces = 0;
+    int max_bounces = 0;
+
+    void add(const MatchResult &result)
+    {
+        this->matches++;
+        if      (result.points_for > result.points_against) this->wins++;
+        else if (result.points_for < result.points_against) this->losses++;
+        else                                                 this->draws++;
+
+        this->points_for     += result.points_for;
+        this->points_against += result.points_against;
+        this->rallies        += result.rallies;
+        this->rally_hits     += result.rally_hits;
+        this->rally_ticks    += result.rally_ticks;
+        this->bounces        += result.bounces;
+        this->max_bounces     = std::max(this->max_bounces, result.max_bounces);
+    }
+};
+
+// Spreads neighbouring schedule slots across the whole seed space (SplitMix64)
+uint64_t mix_seed(uint64_t value)
+{
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+// One match being played, with everything it needs to go on from tick to tick
+struct Match
+{
+    std::mt19937 serve_random;
+    Paddle left,
+           right;
+    Ball balls[Ball::MAX_AMOUNT];
+    bool first_on_left;
+    MatchResult result;
+    int hits = 0,
+        rally_start = 0;
+    bool is_over = false;
+
+    /**
+     * Sets up a match serving from its own generator. The first policy of
+     * the pairing plays on the left when first_on_left is set.
+     */
+    Match(const PaddlePolicy &first, const PaddlePolicy &second, bool first_on_left, int ball_count, uint64_t seed)
+        : left(-Paddle::INIT_POS, 0),
+          right(Paddle::INIT_POS, 0),
+          first_on_left(first_on_left)
+    {
+        std::seed_seq seed_sequence = { (uint32_t) seed, (uint32_t) (seed >> 32) };
+        this->serve_random.seed(seed_sequence);
+        g_serve_random = &this->serve_random;
+
+        assign_policy(&this->left, first_on_left ? first : second);
+        assign_policy(&this->right, first_on_left ? second : first);
+
+        for (int i = 0; i < Ball::MAX_AMOUNT; i++)
+        {
+            this->balls[i].reset();
+            if (i < ball_count) this->balls[i].enable();
+        }
+        update_transforms(&this->left, &this->right, this->balls, Ball::MAX_AMOUNT);
+
+        g_serve_random = nullptr;
+    }
+
+    // The paddle the first or the second policy of the pairing plays
+    Paddle* get_paddle(bool first)
+    {
+        return first == this->first_on_left ? &this->left : &this->right;
+    }
+
+    Paddle* get_opponent(bool first)
+    {
+        return first == this->first_on_left ? &this->right : &this->left;
+    }
+
+    // As update_match, after the policies have set their paddles going, counting each rally as it goes
+    void step(uint32_t tick)
+    {
+        g_serve_random = &this->serve_random;
+
+        update_paddle(DELTA_TIME, &this->left, 1, nullptr, 0);
+        update_paddle(DELTA_TIME, &this->right, 2, nullptr, 0);
+
+        for (Ball &ball : this->balls)
+        {
+            if (!ball.get_status()) continue;
+
+            bool hit_paddle;
+            bool scored = step_ball(DELTA_TIME, ball, &this->left, &this->right, nullptr, false, hit_paddle);
+            if (hit_paddle) this->hits++;
+            if (!scored) continue;
+
+            this->result.rallies++;
+            this->result.rally_hits  += this->hits;
+            this->result.rally_ticks += tick + 1 - this->rally_start;
+            this->result.bounces     += ball.get_bounces();
+            this->result.max_bounces  = std::max(this->result.max_bounces, ball.get_bounces());
+            this->hits        = 0;
+            this->rally_start = tick + 1;
+
+            for (Ball &each : this->balls) each.reset();
+            break;
+        }
+        update_transforms(&this->left, &this->right, this->balls, Ball::MAX_AMOUNT);
+
+        g_serve_random = nullptr;
+
+        this->is_over = tick + 1 >= MAX_MATCH_TICKS || this->left.check_score() || this->right.check_score();
+        if (this->is_over)
+        {
+            this->result.points_for     = this->get_paddle(true)->get_score();
+            this->result.points_against = this->get_opponent(true)->get_score();
+        }
+    }
+};
+
+/**
+ * Plays a batch of one pairing's matches in lockstep on the calling thread.
+ * Each tick, each policy decides for every paddle it plays in the batch in
+ * one go.
+ */
+void play_batch(const PaddlePolicy &first, const PaddlePolicy &second, std::vector<Match> &matches)
+{
+    std::vector<PaddleObservation> observations;
+    std::vector<int32_t> directions;
+    std::vector<Match*> playing;
+    observations.reserve(matches.size());
+    directions.resize(matches.size());
+    playing.reserve(matches.size());
+
+    for (uint32_t tick = 0; ; tick++)
+    {
+        playing.clear();
+        for (Match &match : matches)
+        {
+            if (!match.is_over) playing.push_back(&match);
+        }
+        if (playing.empty()) return;
+
+        for (bool is_first : { true, false })
+        {
+            const PaddlePolicy &policy = is_first ? first : second;
+            if (policy.is_cpu()) continue;
+
+            observations.clear();
+            for (Match *match : playing)
+            {
+                observations.push_back(observe(match->get_paddle(is_first), match->get_opponent(is_first),
+                                               match->balls, Ball::MAX_AMOUNT, tick));
+            }
+
+            decide_batch(policy, observations.data(), (int) observations.size(), directions.data());
+            for (size_t i = 0; i < playing.size(); i++)
+            {
+                set_paddle_direction(playing[i]->get_paddle(is_first), directions[i]);
+            }
+        }
+
+        for (Match *match : playing) match->step(tick);
+    }
+}
+
+void print_rally_columns(const Tally &tally)
+{
+    double rallies = std::max(1, tally.rallies);
+    std::printf("%.3f,%.3f,%.3f,%d\n", tally.rally_hits / rallies, tally.rally_ticks / rallies,
+                tally.bounces / rallies, tally.max_bounces);
+}
+
+int main(int argc, char *argv[])
+{
+    int matches = 100,
+        ball_count = 1,
+        batch_size = 64;
+    uint64_t seed = 3113;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<const PaddlePolicy*> policies;
+    std::vector<std::unique_ptr<PolicyPlugin>> plugins;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp(argv[i], "--matches") == 0 && i + 1 < argc) matches = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)    seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = (unsigned int) std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc)
+        {
+            ball_count = std::min(std::max(1, atoi(argv[++i])), Ball::MAX_AMOUNT);
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)   batch_size = std::max(1, atoi(argv[++i]));
+        else if (strncmp(argv[i], "--", 2) != 0)
+        {
+            plugins.emplace_back(new PolicyPlugin());
+
+            const PaddlePolicy *policy = find_or_load_policy(argv[i], *plugins.back());
+            if (policy == nullptr && plugins.back()->get_error().empty())
+            {
+                std::fprintf(stderr, "Error: no policy called %s\n", argv[i]);
+                return 1;
+            }
+            if (policy == nullptr)
+            {
+                std::fprintf(stderr, "Error: %s\n", plugins.back()->get_error().c_str());
+                return 1;
+            }
+            policies.push_back(policy);
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--matches K] [--seed S] [--threads N] [--balls N] [--batch N] "
+                                 "[POLICY | PLUGIN...]\n", argv[0]);
+            std::fprintf(stderr, "policies:");
+            for (const PaddlePolicy &policy : BUILT_IN_POLICIES) std::fprintf(stderr, " %s", policy.name);
+            std::fprintf(stderr, "\n");
+            return 1;
+        }
+    }
+
+    if (policies.empty())
+    {
+        for (const PaddlePolicy &policy : BUILT_IN_POLICIES) policies.push_back(&policy);
+    }
+    if (policies.size() < 2)
+    {
+        std::fprintf(stderr, "Error: a tournament needs at least two policies\n");
+        return 1;
+    }
+
+    // Every pairing, each playing its matches in a row
+    std::vector<std::pair<int, int>> pairings;
+    for (int first = 0; first < (int) policies.size(); first++)
+    {
+        for (int second = first + 1; second < (int) policies.size(); second++) pairings.push_back({ first, second });
+    }
+
+    // Batches never span two pairings, so each has the same two policies throughout
+    int match_count = (int) pairings.size() * matches,
+        batches_per_pairing = (matches + batch_size - 1) / batch_size,
+        batch_count = (int) pairings.size() * batches_per_pairing;
+    std::vector<MatchResult> results(match_count);
+    std::atomic<int> next_batch(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Each thread takes the next unplayed batch until none are left
+    auto play = [&]()
+    {
+        std::vector<Match> batch;
+        batch.reserve(batch_size);
+
+        for (int b = next_batch++; b < batch_count; b = next_batch++)
+        {
+            const std::pair<int, int> &pairing = pairings[b / batches_per_pairing];
+            const PaddlePolicy &first  = *policies[pairing.first],
+                               &second = *policies[pairing.second];
+
+            int first_match = (b / batches_per_pairing) * matches + (b % batches_per_pairing) * batch_size,
+                last_match  = std::min(first_match + batch_size, (b / batches_per_pairing + 1) * matches);
+
+            batch.clear();
+            for (int match = first_match; match < last_match; match++)
+            {
+                batch.emplace_back(first, second, match % 2 == 0, ball_count, mix_seed(seed ^ mix_seed((uint64_t) match)));
+            }
+
+            play_batch(first, second, batch);
+            for (int match = first_match; match < last_match; match++) results[match] = batch[match - first_match].result;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < threads; i++) workers.emplace_back(play);
+    play();
+    for (std::thread &worker : workers) worker.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<Tally> standings(policies.size());
+    std::printf("policy,opponent,matches,wins,losses,draws,points_for,points_against,"
+                "mean_rally_hits,mean_rally_ticks,mean_bounces,max_bounces\n");
+    for (int p = 0; p < (int) pairings.size(); p++)
+    {
+        Tally pairing_tally;
+        for (int match = p * matches; match < (p + 1) * matches; match++)
+        {
+            const MatchResult &result = results[match];
+            MatchResult mirrored = result;
+            std::swap(mirrored.points_for, mirrored.points_against);
+
+            pairing_tally.add(result);
+            standings[pairings[p].first].add(result);
+            standings[pairings[p].second].add(mirrored);
+        }
+
+        std::printf("%s,%s,%d,%d,%d,%d,%d,%d,", policies[pairings[p].first]->name, policies[pairings[p].second]->name,
+                    pairing_tally.matches, pairing_tally.wins, pairing_tally.losses, pairing_tally.draws,
+                    pairing_tally.points_for, pairing_tally.points_against);
+        print_rally_columns(pairing_tally);
+    }
+
+    // Standings, most wins first
+    std::vector<int> order(policies.size());
+    for (int i = 0; i < (int) order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return standings[a].wins > standings[b].wins; });
+
+    std::printf("\npolicy,matches,wins,losses,draws,win_percent,points_for,points_against,"
+                "mean_rally_hits,mean_rally_ticks,mean_bounces,max_bounces\n");
+    for (int i : order)
+    {
+        const Tally &tally = standings[i];
+        std::printf("%s,%d,%d,%d,%d,%.1f,%d,%d,", policies[i]->name, tally.matches, tally.wins, tally.losses,
+                    tally.draws, 100.0 * tally.wins / tally.matches, tally.points_for, tally.points_against);
+        print_rally_columns(tally);
+    }
+
+    std::fprintf(stderr, "Played %d matches on %u threads in %.2f s (%.0f matches/s)\n", match_count, threads, seconds,
+                 match_count / seconds);
+    return 0;
+}